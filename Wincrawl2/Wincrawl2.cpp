@@ -1,7 +1,6 @@
 ﻿#define dbg std::raise(SIGINT)
 
 #include <iostream>
-#include <random>
 #include <unordered_map>
 #include <memory>
 
@@ -17,6 +16,7 @@
 #include "seq.hpp"
 #include "triggers.hpp"
 #include "view.hpp"
+#include "world.hpp"
 
 
 
@@ -31,50 +31,64 @@ int main() {
 
 	cerr << "⌛ Generating...\n";
 
-	Tile tile0{};
+	TileArena scratchTiles{ 3 };
+	Tile tile0{ scratchTiles[0] };
 	cerr << "tiles: " << tile0 << "\n";
 
-	Tile tile1{};
-	tile0.link(&tile1, 1, 3);
+	Tile tile1{ scratchTiles[1] };
+	tile0.link(tile1, 1, 3);
 	cerr << "tiles: " << tile0 << " " << tile1 << "\n";
 
-	Tile tile2{};
-	tile0.insert(&tile2, 1, 2);
+	Tile tile2{ scratchTiles[2] };
+	tile0.insert(tile2, 1, 2);
 	cerr << "tiles: " << tile0 << " " << tile1 << " " << tile2 << "\n";
 	
-	std::minstd_rand rng { 6 }; //Note: Can call .seed(x) if needed. Does not return same on all platforms.
-	(void) rng(); //Advance one step, initial value seems to be the seed otherwise. Cast to void to avoid VS unused value warning.
-	Plane plane0{ rng, 10 };
-	
-	{
-		//Drop the player into the world.
-		using namespace Component;
-		using namespace Event;
-		Entity* avatar{ plane0.summon() };
-		avatar->add<Existance>("@", 0xDDA24EFF);
-		avatar->add<Fragility>(10);
-		DealDamage dam{ 10 };
-		auto attack{ TakeDamage(avatar->dispatch(DealDamage{})) };
-		cerr << "Attack amount: " << attack.amount << "\n";
-		plane0.getStartingTile()->occupants.push_back(avatar);
+	//Seed, memory budget, and where to put planes which don't fit. The same seed gives the same world on all platforms.
+	World world{ 6, 64 << 20, std::filesystem::temp_directory_path() / "wincrawl" };
+	const auto home{ world.addPlane() };
+	for (World::PlaneId previous{ home }; world.size() < 4;) { //A short chain of planes to wander off into.
+		const auto next{ world.addPlane() };
+		world.connect(previous, next);
+		previous = next;
 	}
-	
+	Tile start{};
 	{
-		//Drop in a few enemies as well.
-		using namespace Component;
-		using namespace Event;
-		for (int i=0; i < 3; i++) {
-			Entity* enemy{ plane0.summon() };
-			enemy->add<Existance>("g", 0xDDA24EFF);
-			enemy->add<Fragility>(4);
-			auto attack{ TakeDamage(enemy->dispatch(DealDamage{})) };
+		//Planes can be evicted once we're walking about, so only hold on to
+		//this one while setting up.
+		Plane& plane0{ world.plane(home) }; //Rooms are built as they come into view.
+		
+		{
+			//Drop the player into the world.
+			using namespace Component;
+			using namespace Event;
+			Entity* avatar{ plane0.summon() };
+			avatar->add<Existance>("@", 0xDDA24EFF);
+			avatar->add<Fragility>(10);
+			DealDamage dam{ 10 };
+			auto attack{ TakeDamage(avatar->dispatch(DealDamage{})) };
 			cerr << "Attack amount: " << attack.amount << "\n";
-			plane0.getStartingTile()->occupants.push_back(enemy);
+			plane0.getStartingTile()->occupants().push_back(avatar);
 		}
+		
+		{
+			//Drop in a few enemies as well.
+			using namespace Component;
+			using namespace Event;
+			for (int i=0; i < 3; i++) {
+				Entity* enemy{ plane0.summon() };
+				enemy->add<Existance>("g", 0xDDA24EFF);
+				enemy->add<Fragility>(4);
+				auto attack{ TakeDamage(enemy->dispatch(DealDamage{})) };
+				cerr << "Attack amount: " << attack.amount << "\n";
+				plane0.getStartingTile()->occupants().push_back(enemy);
+			}
+		}
+		
+		start = plane0.getStartingTile();
 	}
 	
 
-	View view{ 23, 23, plane0.getStartingTile() };
+	View view{ 23, 23, start };
 	
 
 	Color aColor = Color(Color::RGB(0xe6, 0x55, 0x51));
@@ -105,22 +119,23 @@ int main() {
 			&view,
 			Triggers{{
 				//Linux arrow key sequences.
-				{ "[A", [&]{ view.move(0); } }, //up
-				{ "[B", [&]{ view.move(2); } }, //down
-				{ "[C", [&]{ view.move(1); } }, //left
-				{ "[D", [&]{ view.move(3); } }, //right
+				{ "[A", [&]{ view.move(0); world.collect(view.loc); } }, //up
+				{ "[B", [&]{ view.move(2); world.collect(view.loc); } }, //down
+				{ "[C", [&]{ view.move(1); world.collect(view.loc); } }, //left
+				{ "[D", [&]{ view.move(3); world.collect(view.loc); } }, //right
 				{ "[1;3C", [&]{ view.turn(+1); } }, //cw
 				{ "[1;3D", [&]{ view.turn(-1); } }, //ccw
 				
 				//Windows arrow key sequences. (These are not valid utf8.)
-				{ "\xE0H", [&]{ view.move(0); } }, //up
-				{ "\xE0P", [&]{ view.move(2); } }, //down
-				{ "\xE0M", [&]{ view.move(1); } }, //left
-				{ "\xE0K", [&]{ view.move(3); } }, //right   \xE0 = à?
+				{ "\xE0H", [&]{ view.move(0); world.collect(view.loc); } }, //up
+				{ "\xE0P", [&]{ view.move(2); world.collect(view.loc); } }, //down
+				{ "\xE0M", [&]{ view.move(1); world.collect(view.loc); } }, //left
+				{ "\xE0K", [&]{ view.move(3); world.collect(view.loc); } }, //right   \xE0 = à?
 				{ "\x01\0x155", [&]{ view.turn(+1); } }, //cw - note, this sequence actually starts with a 0, but that doesn't work so well with string processing so we just add 1 to it.
 				{ "\x01\0x157", [&]{ view.turn(-1); } }, //ccw
 				
 				//Other key sequences.
+				{ "m", [&]{ switchScreen(screens.at(Screens::debug)); } }, //memory report
 				{ "q", []{ stopMainLoop = true; } }, 
 				{ "", []{ stopMainLoop = true; } }, //windows, ctrl-c
 			}}
@@ -147,7 +162,14 @@ int main() {
 				{ "r", [&]{ currentScreen = screens.at(Screens::main); } }, //return to game
 				{ "q", []{ stopMainLoop = true; } },
 				{ "", []{ stopMainLoop = true; } }, //windows, ctrl-c
-			}}
+			}},
+			[&](std::ostream& out) {
+				World::PlaneId resident{ 0 };
+				for (World::PlaneId id = 0; id < world.size(); id++) resident += world.isResident(id);
+				out << "Memory held by the " << resident << " of " << world.size() << " planes in memory, in bytes.\n"
+					<< "r) Return to game\n\n"
+					<< world.memoryReport();
+			}
 		) },
 	};
 
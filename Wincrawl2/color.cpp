@@ -44,7 +44,6 @@ Color::Color(HSLA other) {
 	for (int i = 0; i < 4; ++i)
 		channels[i] = int(std::round(channelsIn[i]*255));
 }
-Color::Color(const Color& other) : channels{ other[0], other[1], other[2], other[3] } {}
 
 void Color::rgb(uint8_t r, uint8_t g, uint8_t b) {
 	channels[0] = r;
@@ -105,12 +104,6 @@ Color::HSLA Color::hsla() const {
 	return newcolour;
 }
 
-Color& Color::operator=(const Color& other) {
-	for (int i = 0; i < 4; i++) //bump to 4 to match alpha too
-		channels[i] = other[i];
-	return *this;
-}
-
 Color& Color::operator=(uint32_t rgba) {
 	channels[0] = static_cast<uint8_t>(rgba>>24);
 	channels[1] = static_cast<uint8_t>(rgba>>16&0xFF);
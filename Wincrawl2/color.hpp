@@ -23,7 +23,7 @@ public:
 	Color(HSLA);
 	Color(double h, double s, double l);
 	Color(double h, double s, double l, double a);
-	Color(const Color&);
+	Color(const Color&) = default; //Trivially copyable, so tile colours can be saved and mapped back in as-is.
 	
 	inline int a() { return channels[3]; };
 
@@ -37,7 +37,7 @@ public:
 	void hsla(double h, double s, double l, double a);
 	HSLA hsla() const;
 
-	Color& operator=(const Color&);
+	Color& operator=(const Color&) = default;
 	Color& operator=(uint32_t rgba);
 	
 	bool operator==(const Color&) const;
@@ -0,0 +1,63 @@
+//Things which can be grouped together, such as rooms reachable from each other.
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class DisjointSets {
+	//Union-find over elements numbered 0‥n-1. Each starts in a set of its
+	//own, and sets can be joined but never split. With union by size and
+	//path halving, finding and joining take all but constant time.
+	//(Tarjan, "Efficiency of a Good But Not Linear Set Union Algorithm".)
+
+	std::vector<uint32_t> parents{}; //A set's root is its own parent.
+	std::vector<uint32_t> sizes{}; //How many elements are in a set. Only kept up to date for roots.
+	uint32_t sets{ 0 };
+
+public:
+	inline uint32_t add() { //Add a new element, in a set of its own.
+		const auto element{ static_cast<uint32_t>(parents.size()) };
+		parents.push_back(element);
+		sizes.push_back(1);
+		sets++;
+		return element;
+	}
+
+	inline uint32_t find(uint32_t element) { //The root of element's set.
+		assert(element < parents.size());
+		while (parents[element] != element) {
+			parents[element] = parents[parents[element]];
+			element = parents[element];
+		}
+		return element;
+	}
+
+	inline bool join(uint32_t a, uint32_t b) { //Merge the sets of a and b. Returns false if they were already the same set.
+		a = find(a);
+		b = find(b);
+		if (a == b) return false;
+		if (sizes[a] < sizes[b]) std::swap(a, b);
+		parents[b] = a;
+		sizes[a] += sizes[b];
+		sets--;
+		return true;
+	}
+
+	inline bool isJoined(uint32_t a, uint32_t b) { return find(a) == find(b); }
+
+	inline size_t size() const { return parents.size(); } //Elements, not sets.
+	inline uint32_t setCount() const { return sets; }
+	inline uint32_t largestSetSize() const {
+		uint32_t largest{ 0 };
+		for (uint32_t element = 0; element < parents.size(); element++) {
+			if (parents[element] == element && sizes[element] > largest) largest = sizes[element];
+		}
+		return largest;
+	}
+	inline uint32_t root(uint32_t element) const { //As find, but without shortening paths on the way. For saving.
+		while (parents[element] != element) element = parents[element];
+		return element;
+	}
+};
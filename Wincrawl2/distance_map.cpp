@@ -0,0 +1,171 @@
+//Distances across a plane, for things which want to get somewhere.
+#include <algorithm>
+#include <cassert>
+
+#include "distance_map.hpp"
+
+
+DistanceMap::DistanceMap(Plane const& plane, Distance radius_)
+	: tiles(plane.tiles), radius(radius_), epoch(plane.tiles.epoch)
+{
+	assert(("Radius must leave room to mark tiles unreached.", radius < unreached));
+	grow();
+}
+
+template<typename Function>
+void DistanceMap::forEachNeighbour(TileIndex tile, Function&& function) const {
+	for (auto& link : tiles.topology[tile].links) {
+		if (link && !link.isFrontier() && !link.isPortal()) function(link.tile());
+	}
+}
+
+bool DistanceMap::isGoal(TileIndex tile) const {
+	return std::ranges::binary_search(goals, tile);
+}
+
+void DistanceMap::grow() {
+	if (distances.size() < tiles.size()) distances.resize(tiles.size(), unreached);
+}
+
+void DistanceMap::lower(std::vector<Step> seeds) {
+	//Seeds may be at any distance, so take them nearest first, in between
+	//the tiles queued from them. Both lists stay in order, since each tile
+	//only queues its neighbours one step further on than itself.
+	std::ranges::sort(seeds, {}, &Step::distance);
+	std::vector<Step> queue{};
+	size_t nextSeed{ 0 }, next{ 0 };
+	while (nextSeed < seeds.size() || next < queue.size()) {
+		const bool fromSeeds{ nextSeed < seeds.size() && (next == queue.size() || seeds[nextSeed].distance <= queue[next].distance) };
+		const Step step{ fromSeeds ? seeds[nextSeed++] : queue[next++] };
+		if (step.distance > distances[step.tile]) continue; //Something nearer got here first.
+		distances[step.tile] = step.distance;
+
+		const Distance further{ static_cast<Distance>(step.distance + 1) };
+		if (further > radius) continue;
+		forEachNeighbour(step.tile, [&](TileIndex neighbour) {
+			if (further < distances[neighbour]) {
+				distances[neighbour] = further;
+				queue.push_back({ neighbour, further });
+			}
+		});
+	}
+}
+
+std::vector<DistanceMap::Step> DistanceMap::raise(std::vector<TileIndex> suspects) {
+	//A tile's distance holds as long as a neighbour is one step nearer. If
+	//none are, the way it was counting on is gone, so forget it. Tiles which
+	//were counting on it are then suspect in turn.
+	
+	//Moving a goal can shift the whole far side of the plane a step. Past a
+	//point, it's quicker to start over than to pick through it all.
+	const size_t forgetLimit{ std::max<size_t>(distances.size() / 8, 64) };
+	std::vector<TileIndex> forgotten{};
+	while (!suspects.empty()) {
+		if (forgotten.size() > forgetLimit) {
+			recompute();
+			return {};
+		}
+
+		const TileIndex tile{ suspects.back() };
+		suspects.pop_back();
+		const Distance distance{ at(tile) };
+		if (distance == unreached || isGoal(tile)) continue;
+
+		bool isHeld{ false };
+		if (distance) forEachNeighbour(tile, [&](TileIndex neighbour) { isHeld |= distances[neighbour] == distance - 1; });
+		if (isHeld) continue;
+
+		distances[tile] = unreached;
+		forgotten.push_back(tile);
+		forEachNeighbour(tile, [&](TileIndex neighbour) {
+			if (distances[neighbour] == distance + 1) suspects.push_back(neighbour);
+		});
+	}
+
+	//Whatever ways are left into the forgotten tiles lead in from their edges.
+	std::vector<Step> seeds{};
+	for (TileIndex tile : forgotten) {
+		Distance nearest{ unreached };
+		forEachNeighbour(tile, [&](TileIndex neighbour) { nearest = std::min(nearest, distances[neighbour]); });
+		if (nearest < radius) seeds.push_back({ tile, static_cast<Distance>(nearest + 1) });
+	}
+	return seeds;
+}
+
+void DistanceMap::recompute() {
+	std::ranges::fill(distances, unreached);
+	std::vector<Step> seeds{};
+	for (TileIndex goal : goals) seeds.push_back({ goal, 0 });
+	lower(std::move(seeds));
+}
+
+void DistanceMap::setGoals(std::span<const Tile> goals_) {
+	grow();
+	goals.clear();
+	for (Tile goal : goals_) goals.push_back(goal.index());
+	std::ranges::sort(goals);
+	recompute();
+}
+
+void DistanceMap::addGoal(Tile goal) {
+	grow();
+	goals.insert(std::ranges::upper_bound(goals, goal.index()), goal.index());
+	lower({ { goal.index(), 0 } });
+}
+
+void DistanceMap::removeGoal(Tile goal) {
+	const auto found{ std::ranges::lower_bound(goals, goal.index()) };
+	assert(("Tile is not a goal.", found != goals.end() && *found == goal.index()));
+	goals.erase(found);
+	if (isGoal(goal.index())) return; //It was a goal twice over, so nothing's changed.
+
+	grow();
+	lower(raise({ goal.index() }));
+}
+
+void DistanceMap::moveGoal(Tile from, Tile to) {
+	//Add first, so the tiles near both don't have to be forgotten only to be filled back in.
+	addGoal(to);
+	removeGoal(from);
+}
+
+void DistanceMap::relinked(std::span<const Tile> changed) {
+	//Links which were taken away can only make tiles further, and links
+	//which were added can only make them nearer. Do the former first, so
+	//the latter spreads over the result.
+	grow();
+	std::vector<TileIndex> suspects{};
+	for (Tile tile : changed) suspects.push_back(tile.index());
+	std::vector<Step> seeds{ raise(suspects) };
+	for (TileIndex tile : suspects) {
+		if (distances[tile] != unreached) seeds.push_back({ tile, distances[tile] });
+	}
+	lower(std::move(seeds));
+	epoch = tiles.epoch;
+}
+
+void DistanceMap::inserted(Tile tile) {
+	//The tile took over the link between its neighbours, so their links changed too.
+	std::vector<Tile> changed{ tile };
+	forEachNeighbour(tile.index(), [&](TileIndex neighbour) { changed.push_back(tiles[neighbour]); });
+	relinked(changed);
+}
+
+int8_t DistanceMap::downhill(Tile tile) const {
+	int8_t edge{ -1 };
+	Distance nearest{ at(tile.index()) };
+	const auto& links{ tiles.topology[tile.index()].links };
+	for (int8_t i = 0; i < 6; i++) {
+		const Link link{ links[i] };
+		if (!link || link.isFrontier() || link.isPortal()) continue;
+		if (at(link.tile()) < nearest) {
+			nearest = at(link.tile());
+			edge = i;
+		}
+	}
+	return edge;
+}
+
+size_t DistanceMap::bytes() const {
+	return sizeof(DistanceMap) + distances.capacity() * sizeof(Distance) + goals.capacity() * sizeof(TileIndex);
+}
@@ -0,0 +1,68 @@
+//Distances across a plane, for things which want to get somewhere.
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "places.hpp"
+
+class DistanceMap {
+	//How many steps each tile of a plane is from the nearest of a set of
+	//goals, such as the player or the exits. Instead of each monster searching
+	//for a path, they can all step downhill on the same map.
+	//Every step is the same length, so breadth-first is as good as Dijkstra.
+	//
+	//The map is kept up to date as goals move and tiles are relinked, redoing
+	//only the tiles whose distances change. Only links within the plane are
+	//walked. Frontier and portal links count as walls, so nothing gets built
+	//or loaded to fill the map in. Renumbering the plane's tiles, as
+	//Plane::reorder does, invalidates it. isCurrent() tells whether the
+	//plane has changed since the map was last told about it.
+
+public:
+	typedef uint16_t Distance; //Two bytes a tile.
+	static constexpr Distance unreached{ UINT16_MAX }; //Further than the radius, or cut off from every goal.
+
+private:
+	TileArena const& tiles;
+	const Distance radius; //Tiles further than this from every goal are left unreached, and cost nothing to update.
+	std::vector<Distance> distances{}; //Indexed by tile. Grown to match the plane when it's built out further.
+	std::vector<TileIndex> goals{}; //Sorted. A tile may be a goal more than once.
+	uint32_t epoch; //The plane's topology epoch, as of the last change we were told about.
+
+	struct Step {
+		TileIndex tile;
+		Distance distance;
+	};
+
+	template<typename Function>
+	void forEachNeighbour(TileIndex tile, Function&& function) const;
+	Distance at(TileIndex tile) const { return tile < distances.size() ? distances[tile] : unreached; }
+	bool isGoal(TileIndex tile) const;
+	void grow(); //Cover tiles added to the plane since we last looked.
+
+	void lower(std::vector<Step> seeds); //Spread shorter distances out from seeds, nearest first.
+	std::vector<Step> raise(std::vector<TileIndex> suspects); //Forget distances which no longer lead to a goal. Returns where to fill them back in from.
+	void recompute(); //Work the whole map out again, from the goals.
+
+public:
+	explicit DistanceMap(Plane const& plane, Distance radius_ = unreached - 1);
+
+	void setGoals(std::span<const Tile> goals_); //Replace all goals, and work the map out afresh.
+	void addGoal(Tile goal);
+	void removeGoal(Tile goal); //Once, if it was added more than once.
+	void moveGoal(Tile from, Tile to); //Cheap when the two are next to each other, as few distances change.
+
+	//Tell us tiles were relinked, such as by building past a frontier. Pass
+	//every tile with a link which changed, including ones it was taken from.
+	void relinked(std::span<const Tile> changed);
+	void inserted(Tile tile); //Tell us a tile was put between two others with Tile::insert.
+
+	bool isCurrent() const { return epoch == tiles.epoch; } //No links have changed which we weren't told about.
+	
+	Distance operator[](Tile tile) const { return at(tile.index()); }
+	int8_t downhill(Tile tile) const; //The edge to leave by to get a step nearer a goal, or -1 if there isn't one.
+
+	size_t bytes() const; //Memory held.
+};
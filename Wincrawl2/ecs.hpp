@@ -4,6 +4,7 @@
 #include <type_traits>
 #include <memory>
 #include <set>
+#include <utility>
 #include <vector>
 
 #include "color.hpp"
@@ -154,7 +155,21 @@ public:
 	void rem(auto component) {
 		components.erase(component);
 	}
+	
+	template<typename T>
+	T* get() //The first component of type T, or nullptr if there is none.
+		requires std::is_base_of<Component::Base, T>::value
+	{
+		for (auto& component : components) {
+			if (auto found{ dynamic_cast<T*>(component.get()) }) return found;
+		}
+		return nullptr;
+	}
 
+	void forEachComponent(auto&& function) const {
+		for (auto& component : components) function(std::as_const(*component));
+	}
+	
 	template<typename EventType> //This function must be templated, otherwise the virtual function doesn't get overridden by the correct function.
 	EventType dispatch(EventType event)
 		requires std::is_base_of<Event::Base, EventType>::value
@@ -0,0 +1,57 @@
+//Memory-mapped files, and containers which can use them in place.
+#include "mapping.hpp"
+
+
+//Each OS we support has different ways to map a file.
+#ifdef _MSC_VER
+
+	#include <windows.h>
+
+	FileMapping mapFile(std::filesystem::path const& path) {
+		HANDLE file{ CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+		if (file == INVALID_HANDLE_VALUE) return {};
+
+		LARGE_INTEGER size{};
+		GetFileSizeEx(file, &size);
+		HANDLE mapping{ CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr) };
+		CloseHandle(file);
+		if (!mapping) return {};
+
+		void* view{ MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0) };
+		CloseHandle(mapping); //The view keeps the mapping open.
+		if (!view) return {};
+
+		return {
+			std::shared_ptr<std::byte>{ static_cast<std::byte*>(view), [](std::byte* view) { UnmapViewOfFile(view); } },
+			static_cast<size_t>(size.QuadPart),
+		};
+	}
+
+#else
+
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+
+	FileMapping mapFile(std::filesystem::path const& path) {
+		const int file{ open(path.c_str(), O_RDONLY) };
+		if (file < 0) return {};
+
+		struct stat info{};
+		if (fstat(file, &info) < 0 || !info.st_size) {
+			close(file);
+			return {};
+		}
+		const auto size{ static_cast<size_t>(info.st_size) };
+		void* view{ mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0) };
+		close(file); //The mapping keeps the file open.
+		if (view == MAP_FAILED) return {};
+
+		return {
+			std::shared_ptr<std::byte>{ static_cast<std::byte*>(view), [size](std::byte* view) { munmap(view, size); } },
+			size,
+		};
+	}
+
+#endif
@@ -0,0 +1,77 @@
+//Memory-mapped files, and containers which can use them in place.
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+struct FileMapping {
+	std::shared_ptr<std::byte> data{}; //Unmapped when the last copy goes.
+	size_t size{ 0 };
+};
+
+//Map a whole file copy-on-write. Pages are only read in when touched, and
+//writes go to private pages, never back to the file. Empty if the file
+//couldn't be mapped.
+FileMapping mapFile(std::filesystem::path const& path);
+
+
+template<typename T>
+	requires std::is_trivially_copyable_v<T>
+class MappableVector {
+	//A std::vector which can instead start out borrowing someone else's
+	//memory, such as a mapped file. Elements can be read and written in place.
+	//The first time it has to grow, the borrowed elements are copied out into
+	//memory of its own. Whoever lends the memory must keep it alive until then.
+
+	std::vector<T> owned{};
+	T* borrowed{ nullptr };
+	size_t borrowedSize{ 0 };
+
+	void own() {
+		if (!borrowed) return;
+		owned.assign(borrowed, borrowed + borrowedSize);
+		borrowed = nullptr;
+		borrowedSize = 0;
+	}
+
+public:
+	void borrow(T* data_, size_t size_) {
+		assert(reinterpret_cast<uintptr_t>(data_) % alignof(T) == 0);
+		owned = {};
+		borrowed = data_;
+		borrowedSize = size_;
+	}
+	bool isBorrowed() const { return borrowed; }
+
+	T* data() { return borrowed ? borrowed : owned.data(); }
+	const T* data() const { return borrowed ? borrowed : owned.data(); }
+	size_t size() const { return borrowed ? borrowedSize : owned.size(); }
+	size_t capacity() const { return owned.capacity(); } //Of our own memory. Borrowed memory isn't ours to count.
+	bool empty() const { return !size(); }
+
+	T& operator[](size_t i) { return data()[i]; }
+	const T& operator[](size_t i) const { return data()[i]; }
+	T* begin() { return data(); }
+	T* end() { return data() + size(); }
+	const T* begin() const { return data(); }
+	const T* end() const { return data() + size(); }
+	T& back() { return data()[size() - 1]; }
+
+	void reserve(size_t count) { own(); owned.reserve(count); }
+	void resize(size_t count) { own(); owned.resize(count); }
+	void push_back(T const& value) { own(); owned.push_back(value); }
+	template<class ...Args>
+	T& emplace_back(Args&&... args) { own(); return owned.emplace_back(std::forward<Args>(args)...); }
+	template<class Iterator>
+	void append(Iterator first, Iterator last) { own(); owned.insert(owned.end(), first, last); }
+
+	void swap(MappableVector& other) {
+		std::swap(owned, other.owned);
+		std::swap(borrowed, other.borrowed);
+		std::swap(borrowedSize, other.borrowedSize);
+	}
+};
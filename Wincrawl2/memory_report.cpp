@@ -0,0 +1,54 @@
+//Accounting for where memory goes, for the debug screen.
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "memory_report.hpp"
+
+
+MemoryReport::Item& MemoryReport::operator[](std::string_view name) {
+	const auto item{ std::ranges::find(items, name, &Item::name) };
+	return item != items.end() ? *item : items.emplace_back(Item{ name });
+}
+
+MemoryReport& MemoryReport::operator+=(MemoryReport const& other) {
+	for (auto& item : other.items) {
+		Item& ours{ (*this)[item.name] };
+		ours.count += item.count;
+		ours.usedBytes += item.usedBytes;
+		ours.heldBytes += item.heldBytes;
+		ours.mappedBytes += item.mappedBytes;
+	}
+	return *this;
+}
+
+size_t MemoryReport::heldBytes() const {
+	size_t total{ 0 };
+	for (auto& item : items) total += item.heldBytes;
+	return total;
+}
+
+std::ostream& operator<<(std::ostream& os, MemoryReport const& report) {
+	const auto row{ [&](std::string_view name, auto count, auto average, auto used, auto held, auto wasted, auto mapped) {
+		os << std::left << std::setw(18) << name << std::right //80 columns, to fit the debug screen.
+			<< std::setw(9) << count
+			<< std::setw(6) << average
+			<< std::setw(11) << used
+			<< std::setw(11) << held
+			<< std::setw(11) << wasted
+			<< std::setw(11) << mapped << "\n";
+	} };
+	
+	row("", "count", "avg", "used", "held", "wasted", "mapped");
+	size_t used{ 0 }, held{ 0 }, wasted{ 0 }, mapped{ 0 };
+	for (auto& item : report.items) {
+		row(item.name, item.count, item.count ? (item.usedBytes + item.mappedBytes) / item.count : 0,
+			item.usedBytes, item.heldBytes, item.wastedBytes(), item.mappedBytes);
+		used += item.usedBytes;
+		held += item.heldBytes;
+		wasted += item.wastedBytes();
+		mapped += item.mappedBytes;
+	}
+	row("total", "", "", used, held, wasted, mapped);
+	return os;
+}
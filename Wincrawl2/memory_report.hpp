@@ -0,0 +1,35 @@
+//Accounting for where memory goes, for the debug screen.
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <iosfwd>
+#include <string_view>
+
+struct MemoryReport {
+	//A list of the kinds of things something holds, and how much memory each
+	//kind takes. Built by walking the structures involved, so it isn't cheap.
+	
+	struct Item {
+		std::string_view name;
+		size_t count{ 0 }; //How many of the things there are.
+		size_t usedBytes{ 0 }; //Bytes holding them.
+		size_t heldBytes{ 0 }; //Bytes allocated for them, including spare capacity.
+		size_t mappedBytes{ 0 }; //Bytes used straight from a mapped file, which aren't held.
+		
+		inline size_t wastedBytes() const { return heldBytes > usedBytes ? heldBytes - usedBytes : 0; }
+	};
+	std::deque<Item> items{}; //A deque, so items can be held on to while others are added.
+	
+	Item& operator[](std::string_view name); //The item with this name, added empty if there isn't one yet.
+	MemoryReport& operator+=(MemoryReport const& other); //Add up items with the same names.
+	
+	size_t heldBytes() const;
+	
+	//Note that, as containers' node sizes aren't visible, sizes of sets and
+	//the like are estimated. This is about what a red-black tree node takes
+	//on top of its value: a colour, and parent, left and right pointers.
+	static constexpr size_t treeNodeBytes{ 4 * sizeof(void*) };
+};
+
+std::ostream& operator<<(std::ostream& os, MemoryReport const& report); //As a table, with totals.
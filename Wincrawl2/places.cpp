@@ -2,12 +2,24 @@
 #include <array>
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <functional>
 #include <ranges>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 
 #include "places.hpp"
 #include "seq.hpp"
@@ -19,12 +31,12 @@ struct painter {
 };
 
 
-std::string Tile::listLinks(int8_t hightlightIndex) {
+std::string Tile::listLinks(int8_t hightlightIndex) const {
 	std::stringstream out;
 	out << "Tile " << this->getIDStr() << ":";
 	for (int i = 0; i < 6; i++) {
 		out << " "
-			<< Color(this->links[i].tile() ? 0xF9343EFF : 0x20943EFF).fg()
+			<< Color(this->links()[i] ? 0xF9343EFF : 0x20943EFF).fg()
 			<< (i == hightlightIndex ? seq::bold : "")
 			<< i << seq::reset
 			<< (i == hightlightIndex ? "̲" : "");
@@ -37,9 +49,12 @@ std::ostream& operator<<(std::ostream& os, Tile const& tile) {
 
 	bool hasNeighbours = false;
 	for (int i = 0; i < 6; i++) {
-		if (not tile.links[i].tile()) continue;
+		if (not tile.links()[i]) continue;
 		if (hasNeighbours) os << " ";
-		os << i << "→" << tile.links[i].tile()->id;
+		os << i << "→";
+		if (tile.links()[i].isFrontier()) os << "?";
+		else if (tile.links()[i].isPortal()) os << "⇒" << tile.arena->portals[tile.links()[i].tile()].plane;
+		else os << tile.links()[i].tile();
 		hasNeighbours = true;
 	}
 	if (!hasNeighbours) os << "isolated";
@@ -48,7 +63,7 @@ std::ostream& operator<<(std::ostream& os, Tile const& tile) {
 }
 
 
-void Tile::link(Tile* other, int8_t indexOut, int8_t indexIn) {
+void Tile::link(Tile other, int8_t indexOut, int8_t indexIn) const {
 	//Connect two tiles together, where both connections are free.
 
 	if (indexIn == -1) {
@@ -56,6 +71,7 @@ void Tile::link(Tile* other, int8_t indexOut, int8_t indexIn) {
 	}
 
 	assert(other);
+	assert(other.arena == this->arena); //Links are indices, so they can't cross arenas.
 	assert(indexOut >= 0 && indexOut < 6); //Direction index out of this tile must be specified.
 	assert(indexIn >= 0 && indexIn < 6);
 
@@ -64,41 +80,43 @@ void Tile::link(Tile* other, int8_t indexOut, int8_t indexIn) {
 	//Don't allow resetting tile links here? Use insert for that. (Prevent one-way links. Jumps in perspective are not desired, you can always go back.)
 	//This is more than just an assert because knowing **how** we messed up the linking is very helpful for development.
 	const bool badLink{
-		this->links[indexOut].tile() or
-		other->links[indexIn].tile()
+		this->links()[indexOut] or
+		other.links()[indexIn]
 	};
 	if (badLink) {
 		std::cerr << "\nTile Link Error\n";
 
 		std::cerr << "Tile " << this->getIDStr() << " indexOut " << (int)indexOut;
-		if (this->links[indexOut].tile()) {
+		if (this->links()[indexOut]) {
 			std::cerr << " already points to tile "
-				<< this->links[indexOut].tile()->getIDStr() << ".\n";
+				<< follow(this->links()[indexOut]).getIDStr() << ".\n";
 		}
 		else {
 			std::cerr << " clear.\n";
 		}
 		std::cerr << (this->listLinks(indexOut)) << "\n";
 
-		std::cerr << "Tile " << other->getIDStr() << " indexIn " << (int)indexIn;
-		if (other->links[indexIn].tile()) {
+		std::cerr << "Tile " << other.getIDStr() << " indexIn " << (int)indexIn;
+		if (other.links()[indexIn]) {
 			std::cerr << " already points to tile "
-				<< other->links[indexIn].tile()->getIDStr() << ".\n";
+				<< other.follow(other.links()[indexIn]).getIDStr() << ".\n";
 		}
 		else {
 			std::cerr << " clear.\n";
 		}
-		std::cerr << other->listLinks(indexIn) << "\n\n";
+		std::cerr << other.listLinks(indexIn) << "\n\n";
 
 		assert(false);
 	}
 #endif
 
-	other->links[indexIn].set(this, indexOut);
-	this->links[indexOut].set(other, indexIn);
+	other.links()[indexIn].set(this->id, indexOut);
+	this->links()[indexOut].set(other.id, indexIn);
+	arena->touch(other.id);
+	arena->touch(this->id);
 }
 
-void Tile::insert(Tile* newTile, int8_t indexOut, int8_t indexIn) {
+void Tile::insert(Tile newTile, int8_t indexOut, int8_t indexIn) const {
 	//Put a tile between two connected tiles. (Neither of the tiles otherwise move.)
 
 	if (indexIn == -1) {
@@ -106,70 +124,249 @@ void Tile::insert(Tile* newTile, int8_t indexOut, int8_t indexIn) {
 	}
 
 	assert(newTile);
+	assert(newTile.arena == this->arena);
 	assert(indexOut != indexIn); //Indices in are for the internal tile, since we know the outter tile indices this time.
 	assert(indexOut >= 0 && indexOut < 6); //Direction index out of this tile must be specified.
 	assert(indexIn >= 0 && indexIn < 6);
-	assert(this->links[indexOut].tile()); //Don't allow resetting tile links here? Use insert for that. (Prevent one-way links. Jumps in perspective are not desired, you can always go back.)
-	assert(!newTile->links[indexIn].tile());
-	assert(!newTile->links[oppositeEdge[indexIn]].tile());
+	assert(this->links()[indexOut]); //Don't allow resetting tile links here? Use insert for that. (Prevent one-way links. Jumps in perspective are not desired, you can always go back.)
+	assert(!newTile.links()[indexIn]);
+	assert(!newTile.links()[oppositeEdge[indexIn]]);
 
-	Link& outbound{ this->links[indexOut] };
-	Link& inbound{ outbound.tile()->links[outbound.dir()] };
+	Link& outbound{ this->links()[indexOut] };
+	Link& inbound{ follow(outbound).links()[outbound.dir()] };
 
 	//Copy links to inserted tile's links.
-	newTile->links[indexOut].set(outbound);
-	newTile->links[indexIn].set(inbound);
+	newTile.links()[indexOut].set(outbound);
+	newTile.links()[indexIn].set(inbound);
 
 	//Update source and destTile tile's links.
-	outbound.set(newTile, indexIn);
-	inbound.set(newTile, indexOut);
+	const TileIndex across{ outbound.tile() };
+	outbound.set(newTile.id, indexIn);
+	inbound.set(newTile.id, indexOut);
+	arena->touch(newTile.id);
+	arena->touch(across);
+	arena->touch(this->id);
 }
 
-Link* Tile::getNextTile(int comingFrom, int pointingIn) {
-	//comingFrom is an absolute, a direction index.
-	//pointingIn is a relative direction index. (a rotation around z in quarters)
-	assert(0 <= comingFrom && comingFrom < 6);
-	assert(-4 < pointingIn && pointingIn < 4);
+void Tile::unlink(int8_t indexOut) const {
+	assert(indexOut >= 0 && indexOut < 6);
+	Link& outbound{ this->links()[indexOut] };
+	assert(("Can only unlink tiles, not frontiers or portals.", outbound && !outbound.isFrontier() && !outbound.isPortal()));
+	
+	const TileIndex across{ outbound.tile() };
+	Link& inbound{ arena->topology[across].links[outbound.dir()] };
+	assert(("Link doesn't lead back.", inbound.tile() == this->id && inbound.dir() == indexOut));
+	
+	inbound.set(Link{});
+	outbound.set(Link{});
+	arena->touch(across);
+	arena->touch(this->id);
+}
+
+//How getNextTile used to pick an edge, before the transport table. Kept to check the table against.
+static constexpr int referenceNextEdge(int comingFrom, int pointingIn) {
 	switch (pointingIn) {
-	case +0: return &links[oppositeEdge[comingFrom]];
+	case +0: return Tile::oppositeEdge[comingFrom];
 	case -1:
-	case +3: return &links[rotateCCW[comingFrom]];
+	case +3: return Tile::rotateCCW[comingFrom];
 	case -3:
-	case +1: return &links[rotateCW[comingFrom]];
+	case +1: return Tile::rotateCW[comingFrom];
 	case -2:
-	case +2: return &links[comingFrom];
-	default:
-		std::cerr << "Expected pointingIn to be in range [-3,3]; was " << pointingIn << "\n";
-		assert(false);
-		return nullptr;
+	case +2: return comingFrom;
+	default: return -1;
 	}
 }
 
-Link* Tile::getNextTile(int directionIndex) {
+static_assert(
+	[]{
+		for (int comingFrom = 0; comingFrom < 6; comingFrom++) {
+			for (int pointingIn = -3; pointingIn <= 3; pointingIn++) {
+				if (Tile::transport[comingFrom][pointingIn & 3].edge != referenceNextEdge(comingFrom, pointingIn)) return false;
+			}
+			for (int turn = 0; turn < 4; turn++) {
+				if (Tile::transport[comingFrom][turn].rotation != ((turn + 2) & 3)) return false;
+			}
+		}
+		return true;
+	}(),
+	"Tile::transport must agree with the rotateCW/rotateCCW/oppositeEdge tables."
+);
+
+Link* Tile::getNextTile(int comingFrom, int pointingIn) const {
+	//comingFrom is an absolute, a direction index.
+	//pointingIn is a relative direction index. (a rotation around z in quarters)
+	assert(0 <= comingFrom && comingFrom < 6);
+	assert(-4 < pointingIn && pointingIn < 4);
+	return getNextTile(transport[comingFrom][pointingIn & 3].edge);
+}
+
+Link* Tile::getNextTile(int directionIndex) const {
 	assert(0 <= directionIndex && directionIndex < 6);
-	return &(links[directionIndex]);
+	if (links()[directionIndex].isFrontier()) {
+		assert(("Frontier link in an arena which can't build past it.", arena->onFrontier));
+		arena->onFrontier(id, directionIndex); //May grow the arena, so take the link's address after.
+	}
+	return &(links()[directionIndex]);
+}
+
+std::string Tile::getIDStr() const {
+	constexpr size_t minDigits{ 3 }; //Zero-padded so small ids line up in the debug output. Bigger ids just take more room.
+	const std::string digits{ std::to_string(id) };
+	return digits.size() < minDigits ? std::string(minDigits - digits.size(), '0') + digits : digits;
+}
+
+
+
+TileIndex TileArena::append(TileArena& other) {
+	assert(size() + other.size() < Link::maxTiles);
+	assert(("Can't append an arena with portals, their indices would need rebasing too.", other.portals.empty()));
+	const auto offset{ static_cast<TileIndex>(size()) };
+	
+	if (!offset) { //Nothing to rebase, so just take the other arena's storage.
+		topology.swap(other.topology);
+		render.swap(other.render);
+		std::swap(occupants, other.occupants);
+		std::swap(glyphs, other.glyphs);
+		std::swap(backing, other.backing);
+		epoch = std::max(epoch, other.epoch); //Their tiles were stamped by their epoch, so ours mustn't be behind it.
+		return offset;
+	}
+	
+	reserve(size() + other.size());
+	copy(other);
+	
+	if (!other.occupants.empty()) {
+		occupants.resize(offset);
+		occupants.insert(occupants.end(),
+			std::make_move_iterator(other.occupants.begin()),
+			std::make_move_iterator(other.occupants.end()));
+	}
+	
+	return offset;
+}
+
+TileIndex TileArena::copy(TileArena const& other) {
+	assert(size() + other.size() < Link::maxTiles);
+	assert(("Can't copy an arena with portals, their indices would need rebasing too.", other.portals.empty()));
+	const auto offset{ static_cast<TileIndex>(size()) };
+	
+	topology.append(other.topology.begin(), other.topology.end());
+	for (auto& topo : std::span{ topology.begin() + offset, topology.end() }) {
+		if (offset) for (auto& link : topo.links) link.rebase(offset);
+		topo.changedAt = epoch; //New here, whenever they changed there.
+	}
+	
+	std::vector<uint8_t> glyphMap(other.glyphs.size()); //Their glyph indices to ours.
+	for (size_t i = 0; i < other.glyphs.size(); i++) glyphMap[i] = glyphIndex(other.glyphs[i]);
+	render.append(other.render.begin(), other.render.end());
+	for (auto& tileRender : std::span{ render.begin() + offset, render.end() }) {
+		tileRender.glyph = glyphMap[tileRender.glyph];
+	}
+	
+	return offset;
+}
+
+void TileArena::renumber(std::span<const TileIndex> newIndexOf) {
+	assert(newIndexOf.size() == size());
+	
+	//Every index changes, so everything worked out from them is out of date.
+	epoch++;
+	std::ranges::fill(roomChangedAt, epoch);
+	
+	MappableVector<Topology> newTopology{};
+	MappableVector<Render> newRender{};
+	newTopology.resize(size());
+	newRender.resize(size());
+	for (TileIndex tile = 0; tile < size(); tile++) {
+		Topology& topo{ newTopology[newIndexOf[tile]] = topology[tile] };
+		for (auto& link : topo.links) link.renumber(newIndexOf);
+		topo.changedAt = epoch;
+		newRender[newIndexOf[tile]] = render[tile];
+	}
+	topology.swap(newTopology);
+	render.swap(newRender);
+	
+	if (!occupants.empty()) {
+		std::vector<std::vector<Entity*>> newOccupants(size());
+		for (TileIndex tile = 0; tile < occupants.size(); tile++) {
+			newOccupants[newIndexOf[tile]] = std::move(occupants[tile]);
+		}
+		occupants.swap(newOccupants);
+	}
 }
 
-std::string Tile::getIDStr() {
-	constexpr int idDigitLength = 4;
-	auto buf = std::make_unique<char[]>(idDigitLength);
-	std::snprintf(buf.get(), idDigitLength, "%0*lu", idDigitLength - 1, id);
-	return std::string(buf.get());
+uint8_t TileArena::glyphIndex(const char* glyph) {
+	//There are only ever a handful of glyphs in use, so a linear search is fine.
+	for (size_t i = 0; i < glyphs.size(); i++) {
+		if (!std::strcmp(glyphs[i], glyph)) return static_cast<uint8_t>(i);
+	}
+	assert(("Too many different glyphs in one arena.", glyphs.size() <= UINT8_MAX));
+	glyphs.push_back(glyph);
+	return static_cast<uint8_t>(glyphs.size() - 1);
 }
 
 
 
-Plane::RoomConnectionTile::RoomConnectionTile(Tile* tile_, int8_t dir_) : tile(tile_), dir(dir_) {
-	assert(("Cannot create doorway: Direction does not point to a wall.", !tile->links[dir]));
+size_t TileArena::bytes() const {
+	return topology.capacity() * sizeof(Topology)
+		+ render.capacity() * sizeof(Render)
+		+ glyphs.capacity() * sizeof(glyphs[0])
+		+ portals.capacity() * sizeof(portals[0])
+		+ roomChangedAt.capacity() * sizeof(roomChangedAt[0])
+		+ occupants.capacity() * sizeof(occupants[0]);
+}
+
+void TileArena::reportMemory(MemoryReport& report) const {
+	const auto addArray{ [&](std::string_view name, auto const& array) {
+		auto& item{ report[name] };
+		const size_t elementBytes{ sizeof(array.data()[0]) };
+		item.count += array.size();
+		item.heldBytes += array.capacity() * elementBytes;
+		if constexpr (requires { array.isBorrowed(); }) {
+			if (array.isBorrowed()) {
+				item.mappedBytes += array.size() * elementBytes;
+				return;
+			}
+		}
+		item.usedBytes += array.size() * elementBytes;
+	} };
+	
+	addArray("tile links", topology);
+	addArray("tile render", render);
+	addArray("glyphs", glyphs);
+	addArray("portals", portals);
+	addArray("room change epochs", roomChangedAt);
+	
+	//Most tiles never have anyone standing on them, so empty lists are the waste here.
+	auto& lists{ report["occupant lists"] };
+	auto& occupantsItem{ report["occupants"] };
+	lists.count += occupants.size();
+	lists.heldBytes += occupants.capacity() * sizeof(occupants[0]);
+	for (auto& tileOccupants : occupants) {
+		if (!tileOccupants.empty()) lists.usedBytes += sizeof(tileOccupants);
+		occupantsItem.count += tileOccupants.size();
+		occupantsItem.usedBytes += tileOccupants.size() * sizeof(Entity*);
+		occupantsItem.heldBytes += tileOccupants.capacity() * sizeof(Entity*);
+	}
+}
+
+
+Plane::RoomConnectionTile::RoomConnectionTile(Tile tile_, int8_t dir_) : tile(tile_.index()), dir(dir_) {
+	assert(("Cannot create doorway: Direction does not point to a wall.", !tile_.links()[dir]));
 	
 	tiles.reserve(6);
-	tiles.push_back(tile_);
+	tiles.push_back(tile);
+}
+
+uint32_t Plane::roomOf(TileIndex tile) const {
+	assert(("Tile is not in a room.", tiles.render[tile].roomId >= Tile::firstRoom));
+	return tiles.render[tile].roomId - Tile::firstRoom;
 }
 
-bool Plane::allRoomConnectionsAreFree(std::vector<Room> rooms) {
+bool Plane::allRoomConnectionsAreFree(std::vector<Room> const& rooms) {
 	for (auto& room : rooms) {
 		for (auto& connection : room.connections) {
-			if (connection.tile->links[connection.dir]) {
+			if (tiles[connection.tile].links()[connection.dir]) {
 				return false;
 			}
 		}
@@ -177,41 +374,30 @@ bool Plane::allRoomConnectionsAreFree(std::vector<Room> rooms) {
 	return true;
 };
 
-Plane::Room Plane::genSquareRoom(
+void Plane::Builder::Prefab::genSquare(
 	const uint_fast8_t roomX, const uint_fast8_t roomY,
-	const bool wrapX, const bool wrapY,
-	const Color fg, const Color bg,
-	const uint_fast8_t possibleDoors
+	const bool wrapX, const bool wrapY
 ) {
-	std::vector<std::vector<Tile*>> room{ roomX, {roomY, nullptr} };
+	std::vector<std::vector<TileIndex>> room{ roomX, std::vector<TileIndex>(roomY, Link::none) };
 
 	for (uint_fast8_t x = 0; x < roomX; x++) {
 		for (uint_fast8_t y = 0; y < roomY; y++) {
-			Tile* tile{ newOwnedTile() };
-			room[x][y] = tile;
-
-			tile->roomId = 10;
-			tile->glyph = &" \0 \0.\0,"[d(4) * 2];
-			tile->fgColor = fg;
-			tile->bgColor = bg;
+			room[x][y] = tiles.add();
 		}
 	}
 
 	for (uint_fast8_t x = 0; x < roomX - (!wrapX); x++) { //-0 to loop, -1 to not
 		for (uint_fast8_t y = 0; y < roomY; y++) {
-			room[x][y]->link(room[(x + 1) % roomX][y], 1);
+			tiles[room[x][y]].link(tiles[room[(x + 1) % roomX][y]], 1);
 		}
 	}
 
 	for (uint_fast8_t x = 0; x < roomX; x++) {
 		for (uint_fast8_t y = 0; y < roomY - (!wrapY); y++) { //-0 to loop, -1 to not
-			room[x][y]->link(room[x][(y + 1) % roomY], 2);
+			tiles[room[x][y]].link(tiles[room[x][(y + 1) % roomY]], 2);
 		}
 	}
 	
-	auto doors = possibleDoors;
-	std::vector<RoomConnectionTile> connections{};
-
 	const size_t top         = 0;
 	const size_t left        = 0;
 	const size_t bottom      = roomY - 1;
@@ -226,50 +412,46 @@ Plane::Room Plane::genSquareRoom(
 	if(wrapX && wrapY) { //No walls, no doors.
 	}
 	else if (!wrapX && !wrapY) { //Square room, put one door in each wall.
-		if (doors & 0b0001) connections.emplace_back(room[halfWidth][top       ], 0);
-		if (doors & 0b0010) connections.emplace_back(room[right    ][halfHeight], 1);
-		if (doors & 0b0100) connections.emplace_back(room[halfWidth][bottom    ], 2);
-		if (doors & 0b1000) connections.emplace_back(room[left     ][halfHeight], 3);
+		doors.push_back({ room[halfWidth][top       ], 0, 0b0001 });
+		doors.push_back({ room[right    ][halfHeight], 1, 0b0010 });
+		doors.push_back({ room[halfWidth][bottom    ], 2, 0b0100 });
+		doors.push_back({ room[left     ][halfHeight], 3, 0b1000 });
 	}
 	else if (!wrapX) {
 		if (roomY <= 3) {
-			if (doors & 0b0001) connections.emplace_back(room[left      ][halfHeight ], 3);
-			if (doors & 0b0100) connections.emplace_back(room[right     ][halfHeight ], 1);
+			doors.push_back({ room[left      ][halfHeight ], 3, 0b0001 });
+			doors.push_back({ room[right     ][halfHeight ], 1, 0b0100 });
 		} else {
-			if (doors & 0b0001) connections.emplace_back(room[left      ][topThird   ], 3);
-			if (doors & 0b0010) connections.emplace_back(room[left      ][bottomThird], 3);
-			if (doors & 0b0100) connections.emplace_back(room[right     ][topThird   ], 1);
-			if (doors & 0b1000) connections.emplace_back(room[right     ][bottomThird], 1);
+			doors.push_back({ room[left      ][topThird   ], 3, 0b0001 });
+			doors.push_back({ room[left      ][bottomThird], 3, 0b0010 });
+			doors.push_back({ room[right     ][topThird   ], 1, 0b0100 });
+			doors.push_back({ room[right     ][bottomThird], 1, 0b1000 });
 		}
 	}
 	else if (!wrapY) {
 		if (roomX <= 3) {
-			if (doors & 0b0010) connections.emplace_back(room[halfWidth ][bottom     ], 2);
-			if (doors & 0b1000) connections.emplace_back(room[halfWidth ][top        ], 0);
+			doors.push_back({ room[halfWidth ][bottom     ], 2, 0b0010 });
+			doors.push_back({ room[halfWidth ][top        ], 0, 0b1000 });
 		} else {
-			if (doors & 0b0001) connections.emplace_back(room[leftThird ][bottom     ], 2);
-			if (doors & 0b0010) connections.emplace_back(room[rightThird][bottom     ], 2);
-			if (doors & 0b0100) connections.emplace_back(room[leftThird ][top        ], 0);
-			if (doors & 0b1000) connections.emplace_back(room[rightThird][top        ], 0);
+			doors.push_back({ room[leftThird ][bottom     ], 2, 0b0001 });
+			doors.push_back({ room[rightThird][bottom     ], 2, 0b0010 });
+			doors.push_back({ room[leftThird ][top        ], 0, 0b0100 });
+			doors.push_back({ room[rightThird][top        ], 0, 0b1000 });
 		}
 	}
 	else {
 		assert(!"Logic error.");
 	}
 
-	return Room{ room[roomX / 2][roomY / 2], connections };
+	seed = room[roomX / 2][roomY / 2];
 }
 
-Plane::Room Plane::genConicalRoom(
-	const int height,
-	const Color fg, const Color bg,
-	const uint_least8_t possibleDoors
-) {
+void Plane::Builder::Prefab::genConical(const int height) {
 	//Assemble a cone from an L-shape, gluing together the concave edges.
 	// █  ← top
 	// ██ ← bottom
-	std::vector<std::vector<Tile*>> top{ static_cast<size_t>(height), {static_cast<size_t>(height), nullptr} };
-	std::vector<std::vector<Tile*>> bottom{ static_cast<size_t>(height)*2, {static_cast<size_t>(height), nullptr} };
+	std::vector<std::vector<TileIndex>> top{ static_cast<size_t>(height), std::vector<TileIndex>(height, Link::none) };
+	std::vector<std::vector<TileIndex>> bottom{ static_cast<size_t>(height)*2, std::vector<TileIndex>(height, Link::none) };
 	
 	const auto iota { std::views::iota };
 
@@ -280,170 +462,242 @@ Plane::Room Plane::genConicalRoom(
 	//Gen top tiles.
 	for (int x : iota(0, height)) {
 		for (int y : iota(0, height)) {
-			Tile* tile{ newOwnedTile() };
-			top[x][y] = tile;
-			
-			tile->roomId = 10;
-			tile->glyph = &" \0 \0.\0,"[d(4) * 2];
-			tile->fgColor = fg;
-			tile->bgColor = bg;
+			top[x][y] = tiles.add();
 		}
 	}
 
 	//Gen bottom tiles. (Twice as wide as top, since the top will mesh with the side.)
 	for (int x : iota(0, height * 2)) {
 		for (int y : iota(0, height)) {
-			Tile* tile{ newOwnedTile() };
-			bottom[x][y] = tile;
-
-			tile->roomId = 10;
-			tile->glyph = &" \0 \0.\0,"[d(4) * 2];
-			tile->fgColor = fg;
-			tile->bgColor = bg;
+			bottom[x][y] = tiles.add();
 		}
 	}
 	
 	//Link top tiles horizontally.
 	for (size_t x : iota(0, height-1)) {
 		for (size_t y : iota(0, height)) {
-			top[x][y]->link(top[x+1][y], 1);
+			tiles[top[x][y]].link(tiles[top[x+1][y]], 1);
 		}
 	}
 	
 	//Link top tiles vertically.
 	for (size_t x : iota(0, height)) {
 		for (size_t y : iota(0, height-1)) {
-			top[x][y]->link(top[x][y+1], 2);
+			tiles[top[x][y]].link(tiles[top[x][y+1]], 2);
 		}
 	}
 
 	//Link bottom tiles horizontally.
 	for (size_t x : iota(0, height*2 - 1)) {
 		for (size_t y : iota(0, height)) {
-			bottom[x][y]->link(bottom[x + 1][y], 1);
+			tiles[bottom[x][y]].link(tiles[bottom[x + 1][y]], 1);
 		}
 	}
 
 	//Link bottom tiles vertically.
 	for (size_t x : iota(0, height*2)) {
 		for (size_t y : iota(0, height - 1)) {
-			bottom[x][y]->link(bottom[x][y + 1], 2);
+			tiles[bottom[x][y]].link(tiles[bottom[x][y + 1]], 2);
 		}
 	}
 	
 	//Link first half of the top of bottom tiles with the bottom of top tiles.
 	for (size_t i : iota(0, height)) {
-		top[i][height_-1]->link(bottom[i][0], 2);
+		tiles[top[i][height_-1]].link(tiles[bottom[i][0]], 2);
 	}
 	
 	//Link second half of the top of bottom tiles with the right side of top tiles.
 	for (size_t i : iota(0, height)) {
-		top[height_-1][i]->link(bottom[height_*2-1-i][0], 1, 0);
+		tiles[top[height_-1][i]].link(tiles[bottom[height_*2-1-i][0]], 1, 0);
 	}
 
-	auto doors = possibleDoors;
-	std::vector<RoomConnectionTile> connections{}; //Offset slightly CCW since room is always an even number of tiles wide.
-	if (doors & 0b001) connections.emplace_back(top[height_-1][0], 0);
-	if (doors & 0b010) connections.emplace_back(bottom[0][0], 3);
-	if (doors & 0b100) connections.emplace_back(bottom[height_+1][height_-1], 2);
+	//Offset slightly CCW since room is always an even number of tiles wide.
+	doors.push_back({ top[height_-1][0], 0, 0b001 });
+	doors.push_back({ bottom[0][0], 3, 0b010 });
+	doors.push_back({ bottom[height_+1][height_-1], 2, 0b100 });
+
+	seed = top[height_-1][height_-1];
+}
+
+Plane::Builder::Prefab const& Plane::Builder::prefab(const Prefab::Key key) {
+	//Prefabs don't depend on anything random, so one cache serves every plane
+	//and thread. Entries are never removed, so references to them stay good.
+	//Almost every lookup finds its prefab already built, so genRooms' workers
+	//only share the lock to look, and only take it for themselves to add one.
+	static std::shared_mutex lock{};
+	static std::map<Prefab::Key, std::unique_ptr<Prefab>> prefabs{};
+	{
+		std::shared_lock guard{ lock };
+		if (const auto found{ prefabs.find(key) }; found != prefabs.end()) return *found->second;
+	}
+	
+	//Built outside the lock. If another thread builds the same one meanwhile, theirs is kept.
+	auto built{ std::make_unique<Prefab>() };
+	switch (key.shape) {
+	case Prefab::Shape::square: built->genSquare(key.x, key.y, key.wrapX, key.wrapY); break;
+	case Prefab::Shape::conical: built->genConical(key.x); break;
+	default: assert(("Logic error, invalid prefab shape.", false));
+	}
+	std::unique_lock guard{ lock };
+	return *prefabs.try_emplace(key, std::move(built)).first->second;
+}
 
-	return Room{ top[height_-1][height_-1], connections };
+Plane::Room Plane::Builder::instantiate(
+	Prefab const& prefab,
+	const Color fg, const Color bg,
+	const uint_fast8_t possibleDoors
+) {
+	//The prefab's tiles are already linked to each other, so this is a block copy.
+	const TileIndex offset{ tiles.copy(prefab.tiles) };
+	const auto end{ static_cast<TileIndex>(tiles.size()) };
+	
+	for (TileIndex tile = offset; tile < end; tile++) {
+		tiles.render[tile].roomId = roomId; //Prefabs are shared between rooms, so their tiles are left uninitializedRoom.
+		tiles.render[tile].fgColor = fg;
+		tiles.render[tile].bgColor = bg;
+	}
+	rollFloorGlyphs(offset, end);
+	
+	Room room{ prefab.seed + offset };
+	for (auto& door : prefab.doors) {
+		if (possibleDoors & door.bit) room.connections.emplace_back(tiles[door.tile + offset], door.dir);
+	}
+	return room;
 }
 
-Plane::Room Plane::genHallway(
+Plane::Room Plane::Builder::genSquareRoom(
+	const uint_fast8_t roomX, const uint_fast8_t roomY,
+	const bool wrapX, const bool wrapY,
+	const Color fg, const Color bg,
+	const uint_fast8_t possibleDoors
+) {
+	return instantiate(prefab({ Prefab::Shape::square, roomX, roomY, wrapX, wrapY }), fg, bg, possibleDoors);
+}
+
+Plane::Room Plane::Builder::genConicalRoom(
+	const int height,
+	const Color fg, const Color bg,
+	const uint_least8_t possibleDoors
+) {
+	assert(0 < height && height <= UINT8_MAX / 2);
+	return instantiate(prefab({ Prefab::Shape::conical, static_cast<uint8_t>(height) }), fg, bg, possibleDoors);
+}
+
+Plane::Room Plane::Builder::genHallway(
 	const uint_fast8_t length,
-	const Plane::genHallwayStyle style
+	const Plane::Builder::genHallwayStyle style
 ) {
 	return genHallway(length, 1, style);
 }
-Plane::Room Plane::genHallway(
+//Hallway styles. Each is made once per hallway, then asked for every tile
+//after the first which edge of the tile before to leave by. (1 is straight
+//on, 0 and 2 turn.) To add a style, write one and list it in HallwayStyles.
+struct Plane::Builder::Straight {
+	Straight(Builder&, HallwayRolls const&) {}
+	inline int8_t operator()(size_t, size_t) const { return 1; }
+};
+
+struct Plane::Builder::ZigZag {
+	int rotation, type;
+	ZigZag(Builder&, HallwayRolls const& rolls) : rotation(rolls.zigZagRotation), type(rolls.zigZagType) {}
+	
+	inline int8_t operator()(size_t tileNum, size_t totalTiles) const {
+		constexpr std::array<size_t, 2> patSize {2,3};
+		constexpr std::array<std::array<int, 3>, 2> pattern {{
+			{0,1},
+			{0,1,0},
+		}};
+		auto currAbsoluteDirection = pattern[type][static_cast<size_t>((tileNum+0) / 1.0 / (totalTiles+1) * patSize[type])];
+		auto nextAbsoluteDirection = pattern[type][static_cast<size_t>((tileNum+1) / 1.0 / (totalTiles+1) * patSize[type])];
+		return 1 + (currAbsoluteDirection - nextAbsoluteDirection) * rotation;
+	}
+};
+
+struct Plane::Builder::SpiralCW {
+	static constexpr int8_t curves[HallwayRolls::curveTypes][6]{
+		{1, 2, 1, 2, 1, 2}, //small spiral
+		{1, 1, 2, 1, 1, 2}, //med spiral
+		{1, 1, 2, 1, 1, 2}, //med spiral
+		{1, 1, 1, 1, 1, 2}, //large spiral
+		{1, 1, 1, 1, 2, 2}, //staircase
+		{1, 1, 1, 1, 2, 2}, //staircase
+		{1, 2, 2, 1, 1, 1}, //staircase
+	};
+	const int8_t (&curve)[6];
+	SpiralCW(Builder&, HallwayRolls const& rolls) : curve(curves[rolls.curveIndex]) {}
+	inline int8_t operator()(size_t tileNum, size_t) const { return curve[tileNum % 6]; }
+};
+
+struct Plane::Builder::SpiralCCW {
+	static constexpr int8_t curves[HallwayRolls::curveTypes][6]{
+		{1, 0, 1, 0, 1, 0}, //small spiral
+		{1, 1, 0, 1, 1, 0}, //med spiral
+		{1, 1, 0, 1, 1, 0}, //med spiral
+		{1, 1, 1, 1, 1, 0}, //large spiral
+		{1, 1, 1, 1, 0, 0}, //staircase
+		{1, 1, 1, 1, 0, 0}, //staircase
+		{1, 0, 0, 1, 1, 1}, //staircase
+	};
+	const int8_t (&curve)[6];
+	SpiralCCW(Builder&, HallwayRolls const& rolls) : curve(curves[rolls.curveIndex]) {}
+	inline int8_t operator()(size_t tileNum, size_t) const { return curve[tileNum % 6]; }
+};
+
+struct Plane::Builder::Irregular {
+	Builder& builder;
+	Irregular(Builder& builder_, HallwayRolls const&) : builder(builder_) {}
+	inline int8_t operator()(size_t, size_t) const { return static_cast<int8_t>(builder.d(2)); }
+};
+
+Plane::Room Plane::Builder::genHallway(
 	const uint_fast8_t length, const uint_fast8_t width,
-	const Plane::genHallwayStyle style
+	const Plane::Builder::genHallwayStyle style
 ) {
-	//std::cerr << "Creating " << (int)length << "x" << (int)width << " hallway with style " << (int)style << ".\n";
-
-	int totalHallTiles = static_cast<size_t>(length) * static_cast<size_t>(width);
-	std::vector<Tile*> hall{};
-	hall.reserve(totalHallTiles);
-
-	//genHallwayStyle
-	constexpr int CURVE_TYPES { 7 };
-	const int zigZagRotation { d(2) ? -1 : 1 };
-	const int zigZagType { d(2) };
-	const int curveIndex { d(CURVE_TYPES) };
-	static const std::array<std::function<int8_t(size_t, size_t)>, 5> curvature{
-		[](size_t, size_t) { //straight
-			return 1;
-		},
-		[&zigZagRotation, &zigZagType](size_t tileNum, size_t totalTiles) { //zig-zag, must capture closures by reference or they never change across invocations.
-			const std::array<size_t, 2> patSize {2,3};
-			const std::array<std::array<int, 3>, 2> pattern {{
-				{0,1},
-				{0,1,0},
-			}};
-			auto currAbsoluteDirection = pattern[zigZagType][static_cast<size_t>((tileNum+0) / 1.0 / (totalTiles+1) * patSize[zigZagType])];
-			auto nextAbsoluteDirection = pattern[zigZagType][static_cast<size_t>((tileNum+1) / 1.0 / (totalTiles+1) * patSize[zigZagType])];
-			//std::cerr << "zzdir: tile "
-			//	<< tileNum << "/" << totalTiles << " "
-			//	<< 1 + (currAbsoluteDirection - nextAbsoluteDirection) * zigZagRotation
-			//	<< " from " << (int)currAbsoluteDirection << "-" << (int)nextAbsoluteDirection
-			//	<< ", rot " << (int)zigZagRotation << ", type " << (int)zigZagType
-			//	<< "\n";
-			return 1 + (currAbsoluteDirection - nextAbsoluteDirection) * zigZagRotation;
-		},
-		[&curveIndex](size_t tileNum, size_t) { //spiralCW
-			return std::array<std::array<int8_t,6>, CURVE_TYPES>{
-				std::array<int8_t, 6>{1, 2, 1, 2, 1, 2}, //small spiral
-				std::array<int8_t, 6>{1, 1, 2, 1, 1, 2}, //med spiral
-				std::array<int8_t, 6>{1, 1, 2, 1, 1, 2}, //med spiral
-				std::array<int8_t, 6>{1, 1, 1, 1, 1, 2}, //large spiral
-				std::array<int8_t, 6>{1, 1, 1, 1, 2, 2}, //staircase
-				std::array<int8_t, 6>{1, 1, 1, 1, 2, 2}, //staircase
-				std::array<int8_t, 6>{1, 2, 2, 1, 1, 1}, //staircase
-			}[curveIndex][tileNum % 6];
-		},
-		[&curveIndex](size_t tileNum, size_t) { //spiralCCW
-			return std::array<std::array<int8_t,6>, CURVE_TYPES>{
-				std::array<int8_t, 6>{1, 0, 1, 0, 1, 0}, //small spiral
-				std::array<int8_t, 6>{1, 1, 0, 1, 1, 0}, //med spiral
-				std::array<int8_t, 6>{1, 1, 0, 1, 1, 0}, //med spiral
-				std::array<int8_t, 6>{1, 1, 1, 1, 1, 0}, //large spiral
-				std::array<int8_t, 6>{1, 1, 1, 1, 0, 0}, //staircase
-				std::array<int8_t, 6>{1, 1, 1, 1, 0, 0}, //staircase
-				std::array<int8_t, 6>{1, 0, 0, 1, 1, 1}, //staircase
-			}[curveIndex][tileNum % 6];
-		},
-		[this](size_t, size_t) { //irregular
-			return d(2);
-		}
-	};
-	static_assert(curvature.size() == static_cast<int>(genHallwayStyle::COUNT));
+	//Every style gets the same rolls, so the numbers drawn after a hallway don't depend on its style.
+	const HallwayRolls rolls{ d(2) ? -1 : 1, d(2), d(HallwayRolls::curveTypes) };
+	
+	//Find the style's type, so the hallway is built by a loop specialised for it.
+	static_assert(std::tuple_size_v<HallwayStyles> == static_cast<size_t>(genHallwayStyle::COUNT));
+	return [&]<size_t... styles>(std::index_sequence<styles...>) {
+		Room room{};
+		((static_cast<size_t>(style) == styles
+			&& (room = genHallway(length, width, std::tuple_element_t<styles, HallwayStyles>{ *this, rolls }), true)) || ...);
+		return room;
+	}(std::make_index_sequence<std::tuple_size_v<HallwayStyles>>{});
+}
 
-	//std::cerr << "Starting hall: (len " << totalHallTiles << ")\n";
-	hall.emplace_back(newOwnedTile());
-	for (int i : std::views::iota(1,totalHallTiles)) {
-		Tile* head{ hall.back() };
-		Tile* tile{ hall.emplace_back(newOwnedTile()) };
-		
-		auto indexOut = curvature[static_cast<int>(style)](i,totalHallTiles);
-		//std::cerr << "Style " << (int)style << ": " << (int)indexOut << " at step " << i << "/" << totalHallTiles << "\n";
-		head->link(tile, indexOut, 3);
+template<typename Style>
+Plane::Room Plane::Builder::genHallway(
+	const uint_fast8_t length, const uint_fast8_t width,
+	Style const& style
+) {
+	const auto totalHallTiles{ static_cast<TileIndex>(length) * width };
+	
+	//The hall's tiles are allocated one after the other, so they're numbered first‥first+totalHallTiles.
+	const TileIndex first{ newOwnedTile() };
+	tiles[first].roomId() = Tile::hallwayRoom;
+	for (TileIndex i = 1; i < totalHallTiles; i++) {
+		const TileIndex tile{ newOwnedTile() };
+		tiles[tile].roomId() = Tile::hallwayRoom;
+		tiles[tile - 1].link(tiles[tile], style(i, totalHallTiles), 3);
 	}
+	const TileIndex last{ first + totalHallTiles - 1 };
 
 	std::vector<RoomConnectionTile> connections{};
-	connections.emplace_back(hall.front(), 3);
-	connections.emplace_back(hall.back(), 1);
+	connections.emplace_back(tiles[first], 3);
+	connections.emplace_back(tiles[last], 1);
 
-	return Room{ hall.at(totalHallTiles/2), connections };
+	return Room{ first + totalHallTiles/2, connections };
 }
 
-void Plane::linkConnectionsWithHallway(auto& roomAConns, auto& roomBConns) {
+void Plane::linkConnectionsWithHallway(auto& roomAConns, auto& roomBConns, Builder& hallBuilder) {
+	using genHallwayStyle = Builder::genHallwayStyle;
 	auto hallConns{
 		(
-			d(2)
-				? genHallway(1, genHallwayStyle::straight)
-				: genHallway((d(4, 9) + d(4, 9)) / 2,
-					static_cast<genHallwayStyle>(d(static_cast<int>(genHallwayStyle::COUNT))))
+			hallBuilder.d(2)
+				? hallBuilder.genHallway(1, genHallwayStyle::straight)
+				: hallBuilder.genHallway((hallBuilder.d(4, 9) + hallBuilder.d(4, 9)) / 2,
+					static_cast<genHallwayStyle>(hallBuilder.d(static_cast<int>(genHallwayStyle::COUNT))))
 		).connections
 	};
 
@@ -457,118 +711,934 @@ void Plane::linkConnectionsWithHallway(auto& roomAConns, auto& roomBConns) {
 		));
 	}
 
-	RoomConnectionTile roomA{ roomAConns.back() };
-	roomAConns.pop_back(); //Consume used doors.
-	RoomConnectionTile roomB{ roomBConns.back() };
-	roomBConns.pop_back();
+	RoomConnectionTile roomA{ takeConnection(roomAConns) }; //Consume used doors.
+	RoomConnectionTile roomB{ takeConnection(roomBConns) };
 	
 	RoomConnectionTile doorA{ hallConns.at(0) };
 	RoomConnectionTile doorB{ hallConns.at(1) };
 
-	roomA.tile->link(doorA.tile, roomA.dir, doorA.dir);
-	roomB.tile->link(doorB.tile, roomB.dir, doorB.dir);
+	tiles[roomA.tile].link(tiles[doorA.tile], roomA.dir, doorA.dir);
+	tiles[roomB.tile].link(tiles[doorB.tile], roomB.dir, doorB.dir);
+	roomComponents.join(roomOf(roomA.tile), roomOf(roomB.tile));
 
 }
 
-Plane::Plane(std::minstd_rand rng_, int numRooms)
-	: id(TotalPlanesCreated++), rng(rng_)
-{
+Plane::RoomConnectionTile Plane::takeConnection(std::vector<RoomConnectionTile>& connections) {
+	RoomConnectionTile connection{ std::move(connections.back()) };
+	connections.pop_back();
+	roomBytes -= connection.tiles.capacity() * sizeof(TileIndex);
+	return connection;
+}
 
-	//auto choose10 { std::bind(std::uniform_int_distribution<int>{ 0, 10 }, rng) };
-	//std::cerr << "rng says " << d(20) << "\n";
+void Plane::Builder::rollFloorGlyphs(TileIndex first, TileIndex end) {
+	const uint8_t floorGlyphs[4]{ tiles.glyphIndex(" "), tiles.glyphIndex(" "), tiles.glyphIndex("."), tiles.glyphIndex(",") };
+	std::vector<uint32_t> rolls(end - first);
+	glyphRng.fill(rolls);
+	for (TileIndex tile = first; tile < end; tile++) {
+		tiles.render[tile].glyph = floorGlyphs[Philox::scale(rolls[tile - first], 4)];
+	}
+}
 
-	tiles.reserve(512);
-	rooms.reserve(numRooms);
+Plane::Room Plane::Builder::genRoom() {
+	Room room{};
+	switch (d(3)) {
+	case 0:
+	case 1:
+		room = genSquareRoom(
+			d(2, 5) + d(2, 5), d(2, 5) + d(2, 5),
+			!d(4), false,
+			Color{ d(30.,115.), d(58.,  70.), d(35., 50.) },
+			Color{ d(30.,115.), d(70., 100.), d(0.,  6.) }
+		);
+		break;
+	case 2:
+		room = genConicalRoom(
+			d(1, 3) + d(1, 3),
+			Color{ d(30.,115.), d(58.,  70.), d(45., 60.) },
+			Color{ d(30.,115.), d(70., 100.), d(1.,  7.) },
+			0b111
+		);
+	break;
+	default:
+		assert(("Logic error, invalid room type.", false));
+	}
+
+	//Randomise the room's connections.
+	shuffle(room.connections);
+	return room;
+}
+
+void Plane::Room::rebase(TileIndex offset) {
+	seed += offset;
+	for (auto& connection : connections) {
+		connection.tile += offset;
+		for (auto& tile : connection.tiles) tile += offset;
+	}
+}
+
+void Plane::Room::renumber(std::span<const TileIndex> newIndexOf) {
+	seed = newIndexOf[seed];
+	for (auto& connection : connections) {
+		connection.tile = newIndexOf[connection.tile];
+		for (auto& tile : connection.tiles) tile = newIndexOf[tile];
+	}
+}
+
+size_t Plane::Room::heldBytes() const {
+	size_t bytes{ connections.capacity() * sizeof(RoomConnectionTile) };
+	for (auto& connection : connections) bytes += connection.tiles.capacity() * sizeof(TileIndex);
+	return bytes;
+}
+
+void Plane::genRooms(int numRooms) {
+	//Each room is built from its own random number streams, split off the
+	//plane's by its index, so it comes out the same no matter which thread
+	//builds it, and can be rebuilt on its own later.
+	//Rooms are handed out to workers in contiguous runs, and the workers'
+	//arenas are appended in order, so tile indices don't depend on the
+	//number of threads either.
+	constexpr size_t minRoomsPerWorker{ 256 }; //Below this, starting a thread costs more than it saves.
+	const size_t roomCount{ static_cast<size_t>(std::max(numRooms, 0)) };
+	const size_t workerCount{ std::clamp<size_t>(
+		roomCount / minRoomsPerWorker,
+		1, std::max(1u, std::thread::hardware_concurrency())
+	) };
+	const auto firstRoomOf{ [&](size_t worker) { return roomCount * worker / workerCount; } };
 	
-	const auto iota { std::views::iota };
+	rooms.resize(roomCount);
+	for ([[maybe_unused]] auto& room : rooms) roomComponents.add();
+	std::vector<TileArena> workerTiles(workerCount);
+	
+	{
+		std::vector<std::jthread> workers{};
+		workers.reserve(workerCount);
+		for (size_t worker : std::views::iota(size_t(0), workerCount)) {
+			workers.emplace_back([&, worker]{
+				for (size_t room : std::views::iota(firstRoomOf(worker), firstRoomOf(worker + 1))) {
+					rooms[room] = Builder{ workerTiles[worker], rng, static_cast<uint32_t>(room), Tile::firstRoom + static_cast<RoomId>(room) }.genRoom();
+				}
+			});
+		}
+	} //Workers join here.
+	
+	for (size_t worker : std::views::iota(size_t(0), workerCount)) {
+		const TileIndex offset{ tiles.append(workerTiles[worker]) };
+		for (size_t room : std::views::iota(firstRoomOf(worker), firstRoomOf(worker + 1))) {
+			rooms[room].rebase(offset);
+		}
+	}
+	for (auto& room : rooms) roomBytes += room.heldBytes();
+}
 
-	//First, generate a number of rooms.
-	for ([[maybe_unused]] auto _ : iota(0, numRooms)) {
-		switch (d(3)) {
-		case 0:
-		case 1:
-			rooms.emplace_back(genSquareRoom(
-				d(2, 5) + d(2, 5), d(2, 5) + d(2, 5),
-				!d(4), false,
-				Color{ d(30.,115.), d(58.,  70.), d(35., 50.) },
-				Color{ d(30.,115.), d(70., 100.), d(0.,  6.) }
-			));
-			break;
-		case 2:
-			rooms.emplace_back(genConicalRoom(
-				d(1, 3) + d(1, 3),
-				Color{ d(30.,115.), d(58.,  70.), d(45., 60.) },
-				Color{ d(30.,115.), d(70., 100.), d(1.,  7.) },
-				0b111
-			));
-		break;
-		default:
-			assert(("Logic error, invalid room type.", false));
+class RoomsWithDoorways {
+	//The indices of the rooms which have doorways left to link, in no
+	//particular order, so one can be picked at random or taken out in O(1).
+	
+	std::vector<uint32_t> rooms{};
+	std::vector<uint32_t> slotOf{}; //Where each room is in rooms, or none if it's not.
+	static constexpr uint32_t none{ UINT32_MAX };
+	
+public:
+	explicit RoomsWithDoorways(size_t roomCount) : slotOf(roomCount, none) {} //Starting out empty.
+	explicit RoomsWithDoorways(auto const& allRooms) : RoomsWithDoorways(allRooms.size()) {
+		for (uint32_t room = 0; room < allRooms.size(); room++) {
+			if (!allRooms[room].connections.empty()) insert(room);
+		}
+	}
+	
+	bool contains(uint32_t room) const { return slotOf[room] != none; }
+	void insert(uint32_t room) {
+		assert(!contains(room));
+		slotOf[room] = static_cast<uint32_t>(rooms.size());
+		rooms.push_back(room);
+	}
+	void erase(uint32_t room) { //Move the last room into its slot.
+		assert(contains(room));
+		const uint32_t slot{ slotOf[room] };
+		rooms[slot] = rooms.back();
+		slotOf[rooms[slot]] = slot;
+		rooms.pop_back();
+		slotOf[room] = none;
+	}
+	
+	uint32_t operator[](size_t slot) const { return rooms[slot]; }
+	size_t size() const { return rooms.size(); }
+	bool empty() const { return rooms.empty(); }
+};
+
+void Plane::linkRoomsInClusters(uint32_t clusterSize) {
+	//Each room is linked to a random earlier one of its cluster which has a
+	//doorway to spare. The first of each cluster, or any whose cluster has
+	//none to spare, is linked to a random earlier room from anywhere, which
+	//links the clusters up into a tree too. A tree is clusters of one room.
+	RoomsWithDoorways earlier{ rooms.size() };
+	std::vector<uint32_t> inCluster{};
+	for (uint32_t room = 0; room < rooms.size(); room++) {
+		if (room && !rooms[room].connections.empty()) {
+			inCluster.clear();
+			for (uint32_t other = room - room % clusterSize; other < room; other++) {
+				if (earlier.contains(other)) inCluster.push_back(other);
+			}
+			
+			uint32_t parent{ UINT32_MAX };
+			if (!inCluster.empty()) parent = inCluster[builder.rng.below(static_cast<uint32_t>(inCluster.size()))];
+			else if (!earlier.empty()) parent = earlier[builder.rng.below(static_cast<uint32_t>(earlier.size()))];
+			
+			if (parent != UINT32_MAX) {
+				linkConnectionsWithHallway(rooms[room].connections, rooms[parent].connections, builder);
+				if (rooms[parent].connections.empty()) earlier.erase(parent);
+			}
 		}
+		if (!rooms[room].connections.empty()) earlier.insert(room);
+	}
+}
 
-		//Randomise each room's connections.
-		std::shuffle(rooms.back().connections.begin(), rooms.back().connections.end(), rng);
+void Plane::linkStragglers() {
+	//A room can be left out when nothing before it had a doorway to spare.
+	//Rooms which could still be linked to it might come after, though.
+	if (roomComponents.setCount() <= 1) return;
+	
+	std::vector<uint32_t> joined{}, stragglers{};
+	for (uint32_t room = 0; room < rooms.size(); room++) {
+		if (rooms[room].connections.empty()) continue;
+		(roomComponents.isJoined(room, 0) ? joined : stragglers).push_back(room);
+	}
+	for (uint32_t straggler : stragglers) {
+		if (rooms[straggler].connections.empty() || roomComponents.isJoined(straggler, 0)) continue;
+		
+		//Rooms which have run out of doorways are dropped as they're come across.
+		uint32_t slot{};
+		while (!joined.empty() && rooms[joined[slot = builder.rng.below(static_cast<uint32_t>(joined.size()))]].connections.empty()) {
+			joined[slot] = joined.back();
+			joined.pop_back();
+		}
+		if (joined.empty()) break;
+		
+		linkConnectionsWithHallway(rooms[straggler].connections, rooms[joined[slot]].connections, builder);
+		if (!rooms[straggler].connections.empty()) joined.push_back(straggler);
 	}
+}
+
+Plane::Plane(uint64_t seed, int numRooms, Layout layout)
+	: id(TotalPlanesCreated++), rng(seed), builder(tiles, rng, Builder::planeStream)
+{
+	const auto iota { std::views::iota };
+
+	//First, generate a number of rooms.
+	genRooms(numRooms);
 	
 	assert(allRoomConnectionsAreFree(rooms));
 	
 	//Second, link all the rooms up so we don't get stuck.
-	for (size_t i : iota(1, static_cast<int>(rooms.size()))) {
-		linkConnectionsWithHallway(
-			rooms.at(i - 1).connections, 
-			rooms.at(i - 0).connections
-		);
+	switch (layout) {
+	case Layout::chain:
+		for (size_t i : iota(1, static_cast<int>(rooms.size()))) {
+			linkConnectionsWithHallway(
+				rooms.at(i - 1).connections, 
+				rooms.at(i - 0).connections,
+				builder
+			);
+		}
+		break;
+	case Layout::tree:
+		linkRoomsInClusters(1);
+		break;
+	case Layout::clusters:
+		linkRoomsInClusters(8);
+		break;
+	}
+	linkStragglers();
+	if (roomComponents.setCount() > 1) {
+		std::cerr << "Warning: " << roomComponents.setCount() - 1 << " groups of rooms could not be linked to the rest, for want of doorways.\n";
 	}
 	
 	assert(allRoomConnectionsAreFree(rooms));
 	
 	//Third, link up a few more rooms so it's not just a linear labyrinth. (We have consumed over half our linkage opportunities at this point.)
+	//The first room of each link is taken in a shuffled order, and the
+	//second drawn from the rooms which still have doorways, so each link
+	//takes the same time no matter how few doorways are left.
 	const int extraConnections = static_cast<int>(rooms.size()/4);
+	RoomsWithDoorways open{ rooms };
+	const Permutation order{ static_cast<uint32_t>(rooms.size()), uint64_t{ builder.rng() } << 32 | builder.rng() };
+	uint32_t nextInOrder{ 0 };
 	for (int connectionNumber : std::views::iota(0, extraConnections)) {
-		//Replace the following with https://github.com/liamwhite/format-preserving/blob/7da768a732b8bc79d24a5d195a61040271014321/src/main.rs#L3-L58 at some point, it does what we want much better and without the O(n) memory cost.
-		//Constexpr-size only. std::shuffle_order_engine<std::linear_congruential_engine<uint_fast8_t, 1, 1, 10>, 10> order { std::uniform_int_distribution<uint_fast8_t>{ 0, 10-1 }(rng) };
-		
-		Room* connect[2] { nullptr };
-		for (int i : iota(0,2)) {
-			for ([[maybe_unused]] auto attempt : iota(0,10)) {
-				Room* room { &rooms.at(d(static_cast<int>(rooms.size()))) };
-				assert(room); //Silence 'could be null' warning.
-				
-				if (connect[0] == room && room->connections.size() < 2) {
-					//Reject the second room if it's the same as the first room and doesn't have enough connections to connect to itself.
-				}
-				else if (room->connections.size() < 1) {
-					//Reject a room if it doesn't have any connections left.
-				} 
-				else {
-					connect[i] = room;
-					break;
-				}
-			}
+		if (open.empty()) {
+			std::cerr << "Warning: Ran out of spare doorways at room interlink " << connectionNumber << "/" << extraConnections << ".\nWarning: Skipping further interlink steps.\n";
+			break;
 		}
 		
-		if (!connect[0] || !connect[1]) {
+		//Rooms which have run out of doorways are passed over, which only happens once each until we come round again.
+		while (!open.contains(order(nextInOrder))) nextInOrder = (nextInOrder + 1) % rooms.size();
+		const uint32_t first{ order(nextInOrder) };
+		nextInOrder = (nextInOrder + 1) % rooms.size();
+		
+		//A room can only be linked to itself if it has two doorways to spare.
+		if (rooms[first].connections.size() < 2) open.erase(first);
+		if (open.empty()) {
 			std::cerr << "Warning: Could not find spare doorway for room interlink " << connectionNumber << "/" << extraConnections << ".\nWarning: Skipping further interlink steps.\n";
 			break;
 		}
+		const uint32_t second{ open[builder.rng.below(static_cast<uint32_t>(open.size()))] };
 		
-		linkConnectionsWithHallway(connect[0]->connections, connect[1]->connections);
+		linkConnectionsWithHallway(rooms[first].connections, rooms[second].connections, builder);
+		for (uint32_t room : { first, second }) {
+			if (rooms[room].connections.empty() && open.contains(room)) open.erase(room);
+		}
 	}
 	
-	assert(allRoomConnectionsAreFree(rooms));
+	if (!verifyTopology("generation")) throw std::logic_error{ "Generated plane is badly linked." };
+}
+
+Plane::Plane(uint64_t seed)
+	: id(TotalPlanesCreated++), rng(seed), builder(tiles, rng, Builder::planeStream)
+{
+	tiles.onFrontier = [this](TileIndex tile, uint8_t edge) { buildPastFrontier(tile, edge); };
+	
+	rooms.push_back(Builder{ tiles, rng, 0, Tile::firstRoom }.genRoom());
+	roomBytes += rooms.back().heldBytes();
+	roomComponents.add();
+	leaveFrontier(rooms.back(), 0);
+}
+
+void Plane::leaveFrontier(Room& room, uint32_t stream) {
+	//Each doorway's room gets a stream drawn from this room's, so which
+	//room is behind which door is fixed by the seed, not by the order the
+	//doors are opened in.
+	Philox doors{ rng.substream(stream, Builder::doors) };
+	for (auto& connection : room.connections) {
+		frontier.push_back({ connection.tile, static_cast<uint32_t>(connection.dir), doors() });
+		tiles[connection.tile].links()[connection.dir].setFrontier(static_cast<uint32_t>(frontier.size() - 1));
+		roomBytes -= connection.tiles.capacity() * sizeof(TileIndex);
+	}
+	room.connections.clear();
+}
+
+void Plane::buildPastFrontier(TileIndex tile, uint8_t edge) {
+	Link& link{ tiles[tile].links()[edge] };
+	assert(link.isFrontier());
+	const Frontier door{ frontier[link.tile()] };
+	link.set(Link{}); //Free the doorway up to be linked to the hallway.
+	tiles.touch(tile);
+	
+	Builder roomBuilder{ tiles, rng, door.stream, Tile::firstRoom + static_cast<RoomId>(rooms.size()) };
+	rooms.push_back(roomBuilder.genRoom());
+	roomBytes += rooms.back().heldBytes();
+	roomComponents.add();
+	Room& room{ rooms.back() };
+	
+	if (room.connections.empty()) {
+		//Nothing to connect to. Leave the doorway a wall, the room stays unreachable.
+		return;
+	}
+	std::vector<RoomConnectionTile> doorway{ RoomConnectionTile{ tiles[door.tile], static_cast<int8_t>(door.edge) } };
+	roomBytes += doorway.back().tiles.capacity() * sizeof(TileIndex); //Counted like a room's doorway, since using it up takes it off again.
+	linkConnectionsWithHallway(doorway, room.connections, roomBuilder);
+	leaveFrontier(room, door.stream);
+}
+
+std::vector<TileIndex> Plane::visitOrder(bool byDegree) const {
+	//The order doubles as the queue of tiles to visit next.
+	std::vector<TileIndex> order{};
+	order.reserve(tiles.size());
+	std::vector<bool> visited(tiles.size());
+	
+	//Frontier and portal links don't lead anywhere in this arena.
+	const auto isWalkable{ [](Link const& link) { return link && !link.isFrontier() && !link.isPortal(); } };
+	const auto degree{ [&](TileIndex tile) {
+		return std::ranges::count_if(tiles.topology[tile].links, isWalkable);
+	} };
+	
+	const auto visitFrom{ [&](TileIndex start) {
+		//A room at a time. Finish the room we're in before going on to the
+		//ones next to it, so each room's tiles stay together.
+		std::vector<TileIndex> nextRooms{ start }; //Ways into rooms. A room may be listed more than once.
+		for (size_t nextRoom = 0; nextRoom < nextRooms.size(); nextRoom++) {
+			const TileIndex entrance{ nextRooms[nextRoom] };
+			if (visited[entrance]) continue;
+			const RoomId room{ tiles.render[entrance].roomId };
+			visited[entrance] = true;
+			order.push_back(entrance);
+			for (size_t next = order.size() - 1; next < order.size(); next++) {
+				const size_t firstNeighbour{ order.size() };
+				for (auto& link : tiles.topology[order[next]].links) {
+					if (!isWalkable(link) || visited[link.tile()]) continue;
+					if (tiles.render[link.tile()].roomId != room) {
+						nextRooms.push_back(link.tile());
+						continue;
+					}
+					visited[link.tile()] = true;
+					order.push_back(link.tile());
+				}
+				if (byDegree) {
+					std::stable_sort(order.begin() + firstNeighbour, order.end(),
+						[&](TileIndex a, TileIndex b) { return degree(a) < degree(b); });
+				}
+			}
+		}
+	} };
+	
+	if (!rooms.empty()) visitFrom(rooms.front().seed);
+	for (TileIndex tile = 0; tile < tiles.size(); tile++) { //Rooms nothing leads to yet, in lazy planes.
+		if (!visited[tile]) visitFrom(tile);
+	}
+	
+	return order;
+}
+
+void Plane::reorder(TileOrder order) {
+	assert(("Portals into the plane would still use the old tile numbers.", tiles.portals.empty()));
+	
+	std::vector<TileIndex> visits{ visitOrder(order == TileOrder::reverseCuthillMcKee) };
+	if (order == TileOrder::reverseCuthillMcKee) std::ranges::reverse(visits);
+	
+	std::vector<TileIndex> newIndexOf(visits.size());
+	for (TileIndex index = 0; index < visits.size(); index++) newIndexOf[visits[index]] = index;
+	
+	tiles.renumber(newIndexOf);
+	for (auto& room : rooms) room.renumber(newIndexOf);
+	for (auto& door : frontier) door.tile = newIndexOf[door.tile];
 }
 
 Plane::~Plane() {
-	for (auto tile : tiles) { delete tile; }
 	for (auto entity : entities) { delete entity; }
 }
 
+
+//Saving and loading.
+//
+//A saved plane is a header followed by sections of fixed-size records. The
+//sections refer to each other by index, never by pointer, and are aligned so
+//the tile topology and render arrays can be used straight from the mapped
+//file. Native-endian, since it's for swapping planes out to disk and back,
+//not for sharing saves between machines.
+namespace {
+	constexpr uint32_t saveMagic{ 0x4C504357 }; //"WCPL"
+	constexpr uint32_t saveVersion{ 6 };
+	constexpr size_t sectionAlignment{ alignof(TileArena::Topology) };
+	
+	struct Section {
+		uint64_t offset; //Bytes from the start of the header.
+		uint64_t count; //Records.
+	};
+	
+	struct SaveHeader {
+		uint32_t magic{ saveMagic };
+		uint32_t version{ saveVersion };
+		uint32_t byteOrder{ 0x01020304 }; //Reads back differently on a machine of the other endianness.
+		uint16_t topologySize{ sizeof(TileArena::Topology) };
+		uint16_t renderSize{ sizeof(TileArena::Render) };
+		uint64_t seed{ 0 };
+		uint64_t builderPosition{ 0 };
+		uint64_t epoch{ 0 }; //Tiles are saved with their stamps, so the epoch carries on from where it was.
+		Section topology{}, render{}, glyphs{}, portals{}, frontier{};
+		Section rooms{}, connections{}, connectionTiles{};
+		Section entities{}, subentities{}, occupants{};
+	};
+	
+	typedef std::array<char, 8> GlyphText; //Null-terminated. Fixed size, so a glyph table can be indexed.
+	
+	struct RoomRecord {
+		TileIndex seed;
+		uint32_t firstConnection;
+		uint32_t connectionCount;
+		uint32_t component; //Index of the first room it's linked up to, maybe itself.
+	};
+	
+	struct ConnectionRecord {
+		TileIndex tile;
+		int32_t dir; //Wider than it needs to be, so there are no padding bytes to save whatever was left in them.
+		uint32_t firstTile;
+		uint32_t tileCount;
+	};
+	
+	constexpr uint32_t noEntity{ UINT32_MAX };
+	struct EntityRecord {
+		bool hasExistance;
+		bool hasFragility;
+		uint8_t type;
+		uint8_t zorder;
+		GlyphText glyph;
+		Color::RGBA fgColor;
+		uint32_t superentity; //Index into entities, or noEntity.
+		uint32_t firstSubentity;
+		uint32_t subentityCount;
+		int32_t hp;
+	};
+	
+	struct OccupantRecord {
+		TileIndex tile;
+		uint32_t entity;
+	};
+	
+	GlyphText toGlyphText(const char* glyph) {
+		GlyphText text{};
+		assert(("Glyph too long to save.", std::strlen(glyph) < text.size()));
+		std::strncpy(text.data(), glyph, text.size() - 1);
+		return text;
+	}
+	
+	const char* internGlyph(const char* glyph) {
+		//Glyphs are pointers to string literals, which don't survive a round trip. Loaded ones point in here instead.
+		static std::mutex lock{};
+		static std::set<std::string> glyphs{};
+		std::scoped_lock guard{ lock };
+		return glyphs.emplace(glyph).first->c_str();
+	}
+	
+	class SectionWriter {
+		std::ostream& out;
+		const std::streamoff start;
+		
+	public:
+		SectionWriter(std::ostream& out_) : out(out_), start(out_.tellp()) {}
+		
+		template<typename T>
+			requires std::is_trivially_copyable_v<T>
+		Section write(const T* records, size_t count) {
+			static_assert(alignof(T) <= sectionAlignment);
+			static_assert(std::has_unique_object_representations_v<T>,
+				"Saved records can't have padding. Whatever was left in it would be saved too, so the same plane could save differently.");
+			const std::streamoff position{ out.tellp() - start };
+			const std::streamoff padding{ (-position) & static_cast<std::streamoff>(sectionAlignment - 1) };
+			for (std::streamoff i = 0; i < padding; i++) out.put('\0');
+			out.write(reinterpret_cast<const char*>(records), count * sizeof(T));
+			return { static_cast<uint64_t>(position + padding), count };
+		}
+		
+		template<typename T>
+		Section write(std::vector<T> const& records) { return write(records.data(), records.size()); }
+		
+		void finish(SaveHeader const& header) { //Go back and fill in the header, now we know where everything went.
+			const auto end{ out.tellp() };
+			out.seekp(start);
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.seekp(end);
+		}
+	};
+	
+	//A save comes from outside, so nothing in it is taken on trust. These
+	//refuse a file which doesn't hold up, in release builds too.
+	void refuseUnless(bool isGood, const char* why) {
+		if (!isGood) throw Plane::LoadError{ why };
+	}
+	
+	bool isWithin(uint64_t first, uint64_t count, size_t size) { //Does first‥first+count fit in size, without overflowing on the way?
+		return first <= size && count <= size - first;
+	}
+	
+	bool isBool(const bool& value) { //Saved bools are bytes, and anything but 0 or 1 can't be read as one.
+		uint8_t byte;
+		std::memcpy(&byte, &value, 1);
+		return byte <= 1;
+	}
+	
+	bool isTerminated(GlyphText const& text) { return std::ranges::find(text, '\0') != text.end(); }
+	
+	template<typename T>
+	std::span<T> sectionOf(FileMapping const& save, Section const& section) {
+		refuseUnless(section.offset >= sizeof(SaveHeader) && section.count <= save.size / sizeof(T)
+			&& isWithin(section.offset, section.count * sizeof(T), save.size), "Saved plane is truncated.");
+		refuseUnless(section.offset % alignof(T) == 0, "Saved plane has a misaligned section.");
+		return { reinterpret_cast<T*>(save.data.get() + section.offset), section.count };
+	}
+	
+	SaveHeader const& headerOf(FileMapping const& save) {
+		refuseUnless(save.data && save.size >= sizeof(SaveHeader), "Saved plane is missing or empty.");
+		const auto& header{ *reinterpret_cast<const SaveHeader*>(save.data.get()) };
+		refuseUnless(header.magic == saveMagic, "Not a saved plane.");
+		refuseUnless(header.version == saveVersion, "Saved plane is from a different version.");
+		refuseUnless(header.byteOrder == SaveHeader{}.byteOrder, "Saved plane is from a machine of different endianness.");
+		refuseUnless(header.topologySize == sizeof(TileArena::Topology) && header.renderSize == sizeof(TileArena::Render),
+			"Saved plane has a different tile layout.");
+		return header;
+	}
+}
+
+uint64_t Plane::checkSave(FileMapping const& save) {
+	//Everything which indexes something else is checked here, before any
+	//of the save is used, so loading it can take it as it is. Links are
+	//left to checkTopology, except at rooms' spare doorways, which have to
+	//be free before a RoomConnectionTile can be made of them.
+	const SaveHeader& header{ headerOf(save) };
+	
+	const auto topology{ sectionOf<const TileArena::Topology>(save, header.topology) };
+	const auto render{ sectionOf<const TileArena::Render>(save, header.render) };
+	const auto glyphs{ sectionOf<const GlyphText>(save, header.glyphs) };
+	const auto rooms_{ sectionOf<const RoomRecord>(save, header.rooms) };
+	const size_t tileCount{ topology.size() };
+	refuseUnless(tileCount < Link::maxTiles && render.size() == tileCount, "Saved plane's tiles don't add up.");
+	for (auto& tile : topology) refuseUnless(isBool(tile.isOpaque), "Saved tile is neither opaque nor clear.");
+	for (auto& text : glyphs) refuseUnless(isTerminated(text), "Saved glyph is too long.");
+	for (auto& tile : render) {
+		refuseUnless(tile.glyph < glyphs.size(), "Saved tile has a glyph which isn't there.");
+		refuseUnless(tile.roomId < Tile::firstRoom || tile.roomId - Tile::firstRoom < rooms_.size(), "Saved tile is in a room which isn't there.");
+	}
+	
+	for (auto& door : sectionOf<const Frontier>(save, header.frontier)) {
+		refuseUnless(door.tile < tileCount && door.edge < 6, "Saved frontier is off the plane.");
+	}
+	
+	const auto connections{ sectionOf<const ConnectionRecord>(save, header.connections) };
+	const auto connectionTiles{ sectionOf<const TileIndex>(save, header.connectionTiles) };
+	for (auto& room : rooms_) {
+		refuseUnless(room.seed < tileCount && room.component < rooms_.size(), "Saved room is off the plane.");
+		refuseUnless(isWithin(room.firstConnection, room.connectionCount, connections.size()), "Saved room has connections which aren't there.");
+	}
+	for (auto& connection : connections) {
+		refuseUnless(connection.tile < tileCount && 0 <= connection.dir && connection.dir < 6, "Saved connection is off the plane.");
+		refuseUnless(!topology[connection.tile].links[connection.dir], "Saved connection's doorway is already linked.");
+		refuseUnless(isWithin(connection.firstTile, connection.tileCount, connectionTiles.size()), "Saved connection has tiles which aren't there.");
+	}
+	for (auto tile : connectionTiles) refuseUnless(tile < tileCount, "Saved connection tile is off the plane.");
+	
+	const auto entities_{ sectionOf<const EntityRecord>(save, header.entities) };
+	const auto subentities{ sectionOf<const uint32_t>(save, header.subentities) };
+	for (auto& entity : entities_) {
+		refuseUnless(isBool(entity.hasExistance) && isBool(entity.hasFragility) && isTerminated(entity.glyph), "Saved entity is garbled.");
+		refuseUnless(entity.superentity == noEntity || entity.superentity < entities_.size(), "Saved entity is part of one which isn't there.");
+		refuseUnless(isWithin(entity.firstSubentity, entity.subentityCount, subentities.size()), "Saved entity has parts which aren't there.");
+	}
+	for (auto subentity : subentities) refuseUnless(subentity < entities_.size(), "Saved entity has a part which isn't there.");
+	for (auto& occupant : sectionOf<const OccupantRecord>(save, header.occupants)) {
+		refuseUnless(occupant.tile < tileCount && occupant.entity < entities_.size(), "Saved occupant isn't there, or is off the plane.");
+	}
+	
+	sectionOf<const TileArena::Portal>(save, header.portals); //Where they lead is in other planes, and is checked by whoever follows them.
+	return header.seed;
+}
+
+void Plane::save(std::ostream& out) const {
+	SaveHeader header{};
+	header.seed = rng.getSeed();
+	header.builderPosition = builder.rng.tell();
+	header.epoch = tiles.epoch;
+	
+	SectionWriter writer{ out };
+	writer.write(&header, 1); //Placeholder, filled in by finish().
+	
+	header.topology = writer.write(tiles.topology.data(), tiles.topology.size());
+	header.render = writer.write(tiles.render.data(), tiles.render.size());
+	
+	std::vector<GlyphText> glyphs{};
+	for (auto glyph : tiles.glyphs) glyphs.push_back(toGlyphText(glyph));
+	header.glyphs = writer.write(glyphs);
+	
+	header.portals = writer.write(tiles.portals);
+	header.frontier = writer.write(frontier.data(), frontier.size());
+	
+	std::vector<RoomRecord> roomRecords{};
+	std::vector<ConnectionRecord> connectionRecords{};
+	std::vector<TileIndex> connectionTiles{};
+	std::vector<uint32_t> firstRoomOf(rooms.size(), UINT32_MAX); //By component root. Saved instead of the root, which depends on the order rooms were joined in.
+	for (auto& room : rooms) {
+		const auto index{ static_cast<uint32_t>(&room - rooms.data()) };
+		uint32_t& component{ firstRoomOf[roomComponents.root(index)] };
+		if (component == UINT32_MAX) component = index;
+		roomRecords.push_back({ room.seed, static_cast<uint32_t>(connectionRecords.size()), static_cast<uint32_t>(room.connections.size()), component });
+		for (auto& connection : room.connections) {
+			connectionRecords.push_back({ connection.tile, connection.dir, static_cast<uint32_t>(connectionTiles.size()), static_cast<uint32_t>(connection.tiles.size()) });
+			connectionTiles.insert(connectionTiles.end(), connection.tiles.begin(), connection.tiles.end());
+		}
+	}
+	header.rooms = writer.write(roomRecords);
+	header.connections = writer.write(connectionRecords);
+	header.connectionTiles = writer.write(connectionTiles);
+	
+	//Entities point at each other, so number them first.
+	std::unordered_map<Entity*, uint32_t> entityIndex{};
+	for (auto entity : entities) entityIndex.emplace(entity, static_cast<uint32_t>(entityIndex.size()));
+	const auto indexOf{ [&](Entity* entity) {
+		const auto found{ entityIndex.find(entity) };
+		return found == entityIndex.end() ? noEntity : found->second;
+	} };
+	
+	std::vector<EntityRecord> entityRecords{};
+	std::vector<uint32_t> subentities{};
+	for (auto entity : entities) {
+		EntityRecord record{ .superentity = noEntity, .firstSubentity = static_cast<uint32_t>(subentities.size()) };
+		if (auto existance{ entity->get<Component::Existance>() }) {
+			record.hasExistance = true;
+			record.type = existance->type;
+			record.zorder = existance->zorder;
+			record.glyph = toGlyphText(existance->glyph);
+			record.fgColor = existance->fgColor.rgba();
+			record.superentity = indexOf(existance->superentity);
+			for (auto subentity : existance->subentities) {
+				if (indexOf(subentity) != noEntity) subentities.push_back(indexOf(subentity));
+			}
+			record.subentityCount = static_cast<uint32_t>(subentities.size()) - record.firstSubentity;
+		}
+		if (auto fragility{ entity->get<Component::Fragility>() }) {
+			record.hasFragility = true;
+			record.hp = fragility->hp;
+		}
+		entityRecords.push_back(record);
+	}
+	header.entities = writer.write(entityRecords);
+	header.subentities = writer.write(subentities);
+	
+	std::vector<OccupantRecord> occupants{};
+	for (TileIndex tile = 0; tile < tiles.occupants.size(); tile++) {
+		for (auto occupant : tiles.occupants[tile]) {
+			if (indexOf(occupant) != noEntity) occupants.push_back({ tile, indexOf(occupant) });
+		}
+	}
+	header.occupants = writer.write(occupants);
+	
+	writer.finish(header);
+}
+
+Plane::Plane(std::filesystem::path const& file) : Plane(mapFile(file)) {}
+
+Plane::Plane(FileMapping save)
+	: id(TotalPlanesCreated++), rng(checkSave(save)), builder(tiles, rng, Builder::planeStream)
+{
+	//Only the small, pointer-bearing parts of the plane are unpacked here.
+	//The tiles stay in the mapping, and are paged in as they're looked at.
+	const SaveHeader& header{ headerOf(save) };
+	tiles.onFrontier = [this](TileIndex tile, uint8_t edge) { buildPastFrontier(tile, edge); };
+	builder.rng.seek(header.builderPosition);
+	tiles.epoch = static_cast<uint32_t>(header.epoch); //Which rooms changed when isn't kept. Nothing from before the load can be holding on to them.
+	
+	const auto topology{ sectionOf<TileArena::Topology>(save, header.topology) };
+	const auto render{ sectionOf<TileArena::Render>(save, header.render) };
+	tiles.topology.borrow(topology.data(), topology.size());
+	tiles.render.borrow(render.data(), render.size());
+	tiles.backing = save.data;
+	
+	tiles.glyphs.clear();
+	for (auto& text : sectionOf<GlyphText>(save, header.glyphs)) tiles.glyphs.push_back(internGlyph(text.data()));
+	
+	const auto portals{ sectionOf<TileArena::Portal>(save, header.portals) };
+	tiles.portals.assign(portals.begin(), portals.end());
+	
+	const auto frontier_{ sectionOf<Frontier>(save, header.frontier) };
+	frontier.borrow(frontier_.data(), frontier_.size());
+	
+	const auto connections{ sectionOf<ConnectionRecord>(save, header.connections) };
+	const auto connectionTiles{ sectionOf<TileIndex>(save, header.connectionTiles) };
+	const auto roomRecords{ sectionOf<RoomRecord>(save, header.rooms) };
+	for ([[maybe_unused]] auto& record : roomRecords) roomComponents.add();
+	for (auto& record : roomRecords) {
+		roomComponents.join(static_cast<uint32_t>(rooms.size()), record.component);
+		Room& room{ rooms.emplace_back(Room{ record.seed }) };
+		for (auto& connection : connections.subspan(record.firstConnection, record.connectionCount)) {
+			room.connections.emplace_back(tiles[connection.tile], connection.dir).tiles.assign(
+				connectionTiles.begin() + connection.firstTile,
+				connectionTiles.begin() + connection.firstTile + connection.tileCount);
+		}
+		roomBytes += room.heldBytes();
+	}
+	
+	//Before any entities are made, since they wouldn't be freed if we throw.
+	refuseUnless(verifyTopology("loading"), "Saved plane is badly linked.");
+	
+	//Entities point at each other, so create them all before filling them in.
+	const auto entityRecords{ sectionOf<EntityRecord>(save, header.entities) };
+	const auto subentities{ sectionOf<uint32_t>(save, header.subentities) };
+	for ([[maybe_unused]] auto& record : entityRecords) summon();
+	for (size_t i = 0; i < entityRecords.size(); i++) {
+		const EntityRecord& record{ entityRecords[i] };
+		Entity* entity{ entities[i] };
+		if (record.hasExistance) {
+			entity->add<Component::Existance>(
+				internGlyph(record.glyph.data()), Color{ record.fgColor },
+				record.superentity == noEntity ? nullptr : entities.at(record.superentity));
+			auto existance{ entity->get<Component::Existance>() };
+			existance->type = record.type;
+			existance->zorder = record.zorder;
+			for (auto subentity : subentities.subspan(record.firstSubentity, record.subentityCount)) {
+				existance->subentities.insert(entities.at(subentity));
+			}
+		}
+		if (record.hasFragility) {
+			entity->add<Component::Fragility>(record.hp);
+		}
+	}
+	
+	for (auto& occupant : sectionOf<OccupantRecord>(save, header.occupants)) {
+		tiles[occupant.tile].occupants().push_back(entities.at(occupant.entity));
+	}
+}
+
+size_t Plane::bytes() const {
+	//This is checked every turn to keep the world in budget, so it doesn't look
+	//through the tiles or entities. What it leaves out, the occupant lists' contents
+	//and the entities' components, is a few bytes each for the few entities there are.
+	return sizeof(Plane) + tiles.bytes()
+		+ frontier.capacity() * sizeof(Frontier)
+		+ rooms.capacity() * sizeof(Room) + roomBytes
+		+ roomComponents.size() * 2 * sizeof(uint32_t)
+		+ entities.size() * sizeof(Entity) + entities.capacity() * sizeof(Entity*);
+}
+
+MemoryReport Plane::memoryReport() const {
+	MemoryReport report{};
+	tiles.reportMemory(report);
+	
+	auto& frontierItem{ report["frontier"] };
+	frontierItem.count = frontier.size();
+	frontierItem.heldBytes = frontier.capacity() * sizeof(Frontier);
+	(frontier.isBorrowed() ? frontierItem.mappedBytes : frontierItem.usedBytes) = frontier.size() * sizeof(Frontier);
+	
+	auto& roomsItem{ report["rooms"] };
+	auto& connectionsItem{ report["room connections"] };
+	auto& connectionTilesItem{ report["connection tiles"] };
+	roomsItem.count = rooms.size();
+	roomsItem.usedBytes = rooms.size() * sizeof(Room);
+	roomsItem.heldBytes = rooms.capacity() * sizeof(Room);
+	auto& componentsOfRooms{ report["room components"] };
+	componentsOfRooms.count = roomComponents.setCount();
+	componentsOfRooms.usedBytes = roomComponents.size() * 2 * sizeof(uint32_t);
+	componentsOfRooms.heldBytes = componentsOfRooms.usedBytes; //Near enough. The vectors' capacities aren't exposed.
+	for (auto& room : rooms) {
+		connectionsItem.count += room.connections.size();
+		connectionsItem.usedBytes += room.connections.size() * sizeof(RoomConnectionTile);
+		connectionsItem.heldBytes += room.connections.capacity() * sizeof(RoomConnectionTile);
+		for (auto& connection : room.connections) {
+			connectionTilesItem.count += connection.tiles.size();
+			connectionTilesItem.usedBytes += connection.tiles.size() * sizeof(TileIndex);
+			connectionTilesItem.heldBytes += connection.tiles.capacity() * sizeof(TileIndex);
+		}
+	}
+	
+	//Components are only visible through their base class, so look for the ones we know the size of.
+	auto& entitiesItem{ report["entities"] };
+	auto& componentsItem{ report["components"] };
+	auto& subentitiesItem{ report["subentity sets"] };
+	entitiesItem.count = entities.size();
+	entitiesItem.usedBytes = entities.size() * (sizeof(Entity) + sizeof(Entity*));
+	entitiesItem.heldBytes = entities.size() * sizeof(Entity) + entities.capacity() * sizeof(Entity*);
+	for (auto entity : entities) {
+		entity->forEachComponent([&](Component::Base const& component) {
+			size_t bytes{ sizeof(Component::Base) };
+			if (auto existance{ dynamic_cast<Component::Existance const*>(&component) }) {
+				bytes = sizeof(Component::Existance);
+				subentitiesItem.count += existance->subentities.size();
+				subentitiesItem.usedBytes += existance->subentities.size() * (MemoryReport::treeNodeBytes + sizeof(Entity*));
+			}
+			else if (dynamic_cast<Component::Fragility const*>(&component)) {
+				bytes = sizeof(Component::Fragility);
+			}
+			componentsItem.count++;
+			componentsItem.usedBytes += MemoryReport::treeNodeBytes + sizeof(std::unique_ptr<Component::Base>) + bytes;
+		});
+	}
+	componentsItem.heldBytes = componentsItem.usedBytes;
+	subentitiesItem.heldBytes = subentitiesItem.usedBytes;
+	
+	return report;
+}
+
+Plane::TopologyCheck& Plane::TopologyCheck::operator+=(TopologyCheck const& other) {
+	links += other.links;
+	badLinks += other.badLinks;
+	oneWayLinks += other.oneWayLinks;
+	danglingDoors += other.danglingDoors;
+	firstBadTile = std::min(firstBadTile, other.firstBadTile);
+	return *this;
+}
+
+Plane::TopologyCheck Plane::checkTopology() const {
+	//Every tile only reads itself and the tiles it links to, so the tiles
+	//can be split between workers any way we like. The rooms' spare
+	//doorways are split the same way, alongside.
+	constexpr size_t minTilesPerWorker{ 1 << 16 }; //About 1ms of checking. Below this, starting a thread costs more than it saves.
+	const size_t workerCount{ std::clamp<size_t>(
+		tiles.size() / minTilesPerWorker,
+		1, std::max(1u, std::thread::hardware_concurrency())
+	) };
+	const auto shareOf{ [&](size_t count, size_t worker) { return count * worker / workerCount; } };
+	
+	const auto checkTiles{ [&](TileIndex first, TileIndex last, TopologyCheck& check) {
+		const auto bad{ [&](size_t& count, TileIndex tile) {
+			count++;
+			check.firstBadTile = std::min(check.firstBadTile, tile);
+		} };
+		
+		for (TileIndex tile = first; tile < last; tile++) {
+			auto& links{ tiles.topology[tile].links };
+			for (uint8_t edge = 0; edge < std::size(links); edge++) {
+				const Link link{ links[edge] };
+				if (!link) continue;
+				check.links++;
+				
+				if (link.isPortal()) {
+					//Where it comes out is in another plane, which we can't check from here.
+					if (link.isFrontier() || link.dir() >= 6 || link.tile() >= tiles.portals.size()) bad(check.badLinks, tile);
+				}
+				else if (link.isFrontier()) {
+					if (link.tile() >= frontier.size()) bad(check.badLinks, tile);
+					else if (frontier[link.tile()].tile != tile || frontier[link.tile()].edge != edge) bad(check.oneWayLinks, tile);
+				}
+				else if (link.dir() >= 6 || link.tile() >= tiles.size()) {
+					bad(check.badLinks, tile);
+				}
+				else {
+					const Link back{ tiles.topology[link.tile()].links[link.dir()] };
+					if (!back || back.isFrontier() || back.isPortal() || back.tile() != tile || back.dir() != edge) bad(check.oneWayLinks, tile);
+				}
+			}
+		}
+	} };
+	
+	const auto checkDoors{ [&](size_t first, size_t last, TopologyCheck& check) {
+		for (auto& room : std::span{ rooms }.subspan(first, last - first)) {
+			for (auto& door : room.connections) {
+				if (door.tile >= tiles.size() || door.dir < 0 || door.dir >= 6 || tiles.topology[door.tile].links[door.dir]) {
+					check.danglingDoors++;
+					check.firstBadTile = std::min(check.firstBadTile, door.tile);
+				}
+			}
+		}
+	} };
+	
+	std::vector<TopologyCheck> checks(workerCount);
+	{
+		std::vector<std::jthread> workers{};
+		workers.reserve(workerCount);
+		for (size_t worker : std::views::iota(size_t(0), workerCount)) {
+			workers.emplace_back([&, worker]{
+				checkTiles(
+					static_cast<TileIndex>(shareOf(tiles.size(), worker)),
+					static_cast<TileIndex>(shareOf(tiles.size(), worker + 1)),
+					checks[worker]);
+				checkDoors(shareOf(rooms.size(), worker), shareOf(rooms.size(), worker + 1), checks[worker]);
+			});
+		}
+	} //Workers join here.
+	
+	TopologyCheck total{};
+	for (auto& check : checks) total += check;
+	return total;
+}
+
+bool Plane::verifyTopology(const char* after) const {
+	const TopologyCheck check{ checkTopology() };
+	if (check) return true;
+	
+	std::cerr << "\nTopology Error\nPlane " << id << " is badly linked after " << after << ".\n" << check << "\n";
+	if (check.firstBadTile < tiles.size()) {
+		std::cerr << tiles[check.firstBadTile].listLinks() << "\n";
+	}
+	return false;
+}
+
+std::ostream& operator<<(std::ostream& os, Plane::TopologyCheck const& check) {
+	return os << check.links << " links checked: "
+		<< check.badLinks << " bad, "
+		<< check.oneWayLinks << " one-way, "
+		<< check.danglingDoors << " dangling doors. First bad tile "
+		<< (check.firstBadTile == Link::none ? std::string{ "none" } : std::to_string(check.firstBadTile)) << ".";
+}
+
 std::ostream& operator<<(std::ostream& os, Plane const& plane) {
 	os << "Plane " << plane.id << ":\n\t";
 
 	size_t tcount{};
-	for (auto tile : plane.tiles) {
-		os << *tile << ", ";
+	for (TileIndex tile{ 0 }; tile < plane.tiles.size(); tile++) {
+		os << plane.tiles[tile] << ", ";
 		if (not (++tcount % 5) && tcount != plane.tiles.size()) {
 			os << "\n\t";
 		}
@@ -577,8 +1647,8 @@ std::ostream& operator<<(std::ostream& os, Plane const& plane) {
 	return os << "\n";
 }
 
-Tile* Plane::getStartingTile() {
-	return rooms.at(0).seed;
+Tile Plane::getStartingTile() {
+	return tiles[rooms.at(0).seed];
 }
 
 const std::vector<Plane::Room>& Plane::getRooms() {
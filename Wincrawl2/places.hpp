@@ -1,162 +1,527 @@
 //Classes related to places, the tiles of the map itself.
 #pragma once
 
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
 #include <vector>
-#include <random>
 
 #include "color.hpp"
+#include "disjoint_sets.hpp"
 #include "ecs.hpp"
+#include "mapping.hpp"
+#include "memory_report.hpp"
+#include "rng.hpp"
 
 class Tile;
+class TileArena;
+
+typedef uint32_t TileIndex; //Tiles are addressed by their index in the TileArena which owns them.
+typedef uint32_t RoomId; //Which room a tile is part of, numbered per plane. See Tile::roomId().
 
 class Link {
 	//A link is another tile we're linking to, and the direction we enter it by.
+	//Packed into one 32-bit word, so a tile's six links fit in 24 bytes:
+	//
+	//  31 30                           3 2   0
+	//  ┌──┬─────────────────────────────┬─────┐
+	//  │P │       tile index + 1        │ dir │
+	//  └──┴─────────────────────────────┴─────┘
+	//
+	//The index is stored off by one so that an all-zero word is no link.
+	//A dir of 6 marks a frontier link, which leads somewhere that hasn't been
+	//built yet. Its index is then into the plane's frontier list, not a tile.
+	//P marks a portal link, which leads into another plane. Its index is then
+	//into the arena's portal list, and dir is still the direction we emerge.
 
-	Tile* tile_ = nullptr; //Link destination.
-	uint8_t dir_ = 0; //Destination direction in which we emerge. Our entry in its links.
+	static constexpr int dirBits{ 3 };
+	static constexpr uint32_t dirMask{ (1u << dirBits) - 1 };
+	static constexpr uint32_t portalBit{ 1u << 31 };
+	
+	uint32_t bits{ 0 };
+	
+	friend class RayFan; //Decodes links several at a time, straight from the arena.
 
 public:
-	Tile* tile() const { return tile_; };
-	uint8_t dir() const { return dir_; };
+	static constexpr TileIndex none{ UINT32_MAX }; //tile() of an unset link.
+	static constexpr TileIndex maxTiles{ (~portalBit >> dirBits) - 1 }; //Number of tiles a link can address.
+	static constexpr uint8_t frontierDir{ 6 };
 
-	void set(Tile* tile, uint8_t dir) {
-		this->tile_ = tile;
-		this->dir_ = dir;
+	TileIndex tile() const { return ((bits & ~portalBit) >> dirBits) - 1; }; //Link destination, in the same arena as the tile the link belongs to.
+	uint8_t dir() const { return bits & dirMask; }; //Destination direction in which we emerge. Our entry in its links.
+
+	void set(TileIndex tile, uint8_t dir) {
+		assert(tile < maxTiles);
+		assert(dir < 6);
+		this->bits = (tile + 1) << dirBits | dir;
 	}
 
 	void set(Link const& link) {
-		this->tile_ = link.tile();
-		this->dir_ = link.dir();
+		this->bits = link.bits;
+	}
+	
+	void setFrontier(uint32_t frontierId) {
+		assert(frontierId < maxTiles);
+		this->bits = (frontierId + 1) << dirBits | frontierDir;
+	}
+	
+	void setPortal(uint32_t portalId, uint8_t dir) {
+		assert(portalId < maxTiles);
+		assert(dir < 6);
+		this->bits = portalBit | (portalId + 1) << dirBits | dir;
+	}
+	
+	bool isFrontier() const { return dir() == frontierDir; }
+	bool isPortal() const { return bits & portalBit; }
+	
+	void rebase(TileIndex offset) { //Point at the same tile, after its arena was appended to another.
+		if (bits && !isFrontier() && !isPortal()) bits += offset << dirBits;
+	}
+	
+	void renumber(std::span<const TileIndex> newIndexOf) { //Point at the same tile, after its arena was renumbered.
+		if (bits && !isFrontier() && !isPortal()) set(newIndexOf[tile()], dir());
 	}
 	
 	//todo: test this
 	explicit operator bool () const {
-		return this->tile_ != nullptr;
+		return this->bits != 0;
 	}
 };
+static_assert(sizeof(Link) == 4);
 
 
-class Tile : public Entity {
+class Tile {
 	//A tile is a square place in a plane.
+	//This is a handle to the tile, which lives in a TileArena. Pass it around by value, like a pointer.
 
-	inline static uint_fast16_t TotalTilesCreated;
-	const uint_fast16_t id{ 0 };
+	TileArena* arena{ nullptr }; //The arena the tile lives in, which its links index into.
+	TileIndex id{ Link::none }; //The tile's index in the arena.
 
 public:
 	//Let's define some geometry. For edges 0, 1, 2, 3, 4, 5 of a cube:
 	static constexpr uint8_t oppositeEdge[6]{ 2, 3, 0, 1, 5, 4 };
 	static constexpr uint8_t rotateCW[6]{ 1, 2, 3, 0, 1, 3 }; //Rotate around the Z axis, ie, top-down.
 	static constexpr uint8_t rotateCCW[6]{ 3, 0, 1, 2, 3, 1 }; //Going around a corner from the top will land you "facing" east or west, although it could just as easily be north and south as your rotation isn't tracked.
+	
+	//Relative navigation. Having come in by edge comingFrom, turning by turn quarters (0=straight
+	//through, 1=CW, 2=back, 3=CCW) leaves by transport[comingFrom][turn].edge. Once across, a view
+	//which turned so is rotated by oppositeEdge[arrival edge] + rotation. (Checked in places.cpp.)
+	struct Transport { uint8_t edge; uint8_t rotation; };
+	static constexpr Transport transport[6][4]{
+		{ {2,2}, {1,3}, {0,0}, {3,1} },
+		{ {3,2}, {2,3}, {1,0}, {0,1} },
+		{ {0,2}, {3,3}, {2,0}, {1,1} },
+		{ {1,2}, {0,3}, {3,0}, {2,1} },
+		{ {5,2}, {1,3}, {4,0}, {3,1} },
+		{ {4,2}, {3,3}, {5,0}, {1,1} },
+	};
 
+	Tile() {}; //No tile, like a nullptr.
+	Tile(TileArena* arena_, TileIndex id_) : arena(arena_), id(id_) {}
+	
+	inline const Tile* operator->() const { return this; } //So tile->glyph() reads the same as it did when tiles were passed by pointer.
+	explicit operator bool () const { return arena != nullptr; }
+	bool operator==(const Tile&) const = default;
+	
+	inline TileIndex index() const { return id; }
+	inline TileArena* getArena() const { return arena; }
+	inline Tile follow(Link const& link) const; //Returns the tile a link points to, or no tile if there is no link or it's an unbuilt frontier.
+	
 	//Since we are in a non-euclidean space here, N/E/S/W and Up/Down directions don't really make any sense.
 	//However, if it helps, you can think of the links array as being such where N=0.
-	Link links[6]{};
-	uint8_t roomId{ 0 }; //0=uninitialized, 1=hidden, 2=empty, 9=hallway, 10≥rooms
-	const char* glyph{ " " }; //String, 4 bytes + null terminator for utf8 astral plane characters.
-	bool isOpaque{ false };
-	Color bgColor{ 0, 0, 0 };
-	Color fgColor{ 0, 0, 100 };
-	std::vector<Entity*> occupants {};
-	
-	Tile() : id(TotalTilesCreated++) {}
+	inline Link (&links() const)[6];
+	inline bool& isOpaque() const;
+	inline uint32_t changedAt() const; //The arena's epoch when the tile's links last changed, or when it was added.
+	inline RoomId& roomId() const; //One of the below, or firstRoom + the room's index in its plane.
+	static constexpr RoomId uninitializedRoom{ 0 }, hiddenRoom{ 1 }, emptyRoom{ 2 }, hallwayRoom{ 9 }, firstRoom{ 10 };
+	inline const char* glyph() const; //String, 4 bytes + null terminator for utf8 astral plane characters.
+	inline void setGlyph(const char* glyph) const;
+	inline Color& bgColor() const;
+	inline Color& fgColor() const;
+	inline std::vector<Entity*>& occupants() const; //For changing who's here.
+	inline std::vector<Entity*> const& occupantsHere() const; //For looking, which is cheaper for the many tiles nobody has ever stood on.
 	
 	//Debugging functions.
-	std::string getIDStr();
-	std::string listLinks(int8_t hightlightIndex = -1);
+	std::string getIDStr() const;
+	std::string listLinks(int8_t hightlightIndex = -1) const;
 	friend std::ostream& operator<<(std::ostream& os, Tile const& tile);
 
-	void link(Tile* other, int8_t indexOut, int8_t indexIn = -1);
-	void insert(Tile* newTile, int8_t indexOut, int8_t indexIn = -1);
+	void link(Tile other, int8_t indexOut, int8_t indexIn = -1) const;
+	void insert(Tile newTile, int8_t indexOut, int8_t indexIn = -1) const;
+	void unlink(int8_t indexOut) const; //Take a link away, from both ends.
 
-	Link* getNextTile(int comingFrom, int pointingIn);
-	Link* getNextTile(int directionIndex);
+	//Both build whatever lies past a frontier link before returning it, so the link can be followed.
+	Link* getNextTile(int comingFrom, int pointingIn) const;
+	Link* getNextTile(int directionIndex) const;
 
 };
 
 
-class Plane {
-	//A plane is a collection of tiles, which are formed into rooms.
+class TileArena {
+	//Contiguous storage for tiles, so walking links doesn't hop all over the heap.
+	//A tile's index is stable for the life of the arena. Tile data is stored as a
+	//structure of arrays, split by how hot it is: walking the map (the raytracer,
+	//movement) only needs the topology array, so it doesn't drag colours and
+	//occupants through the cache with it.
 	
-	inline static uint_fast16_t TotalPlanesCreated{ 0 };
-	const uint_fast16_t id{ 0 };
-	std::minstd_rand rng;
+	TileArena(TileArena&) = delete; //Tiles point back at their arena.
+	TileArena operator=(TileArena&) = delete;
 
-	//Unfortunately, std::uniform_int_distribution is pretty strongly resistant to templating.
-	//https://stackoverflow.com/questions/55273637/c-templated-uniform-distribution
-	inline int d(int max) {
-		//Returns a number, 𝑛, such that 0 ≤ 𝑛 < max.
-		return d(0, max);
-	};
-	inline int d(int min, int max) {
-		//Returns a number, 𝑛, such that min ≤ 𝑛 < max.
-		return std::uniform_int_distribution<int>{ min, max-1 }(rng);
+public:
+	struct alignas(32) Topology { //Hot. Everything needed to step from tile to tile. Two to a cache line, never split across one.
+		Link links[6]{};
+		bool isOpaque{ false };
+		uint8_t padding[3]{}; //Named, so it's always zeroed. Tiles are saved byte for byte.
+		uint32_t changedAt{ 0 }; //Epoch of the last change to links.
 	};
-	inline double d(double max) {
-		//Returns a number, 𝑛, such that min ≤ 𝑛 ≤ max.
-		return d(0., max);
+	static_assert(sizeof(Topology) == 32);
+	
+	struct Render { //Cold. Only looked at once a tile is on screen.
+		RoomId roomId{ 0 };
+		Color bgColor{ 0, 0, 0 };
+		Color fgColor{ 0, 0, 100 };
+		uint8_t glyph{ 0 }; //Index into glyphs.
+		uint8_t padding[3]{};
 	};
-	inline double d(double min, double max) {
-		//Returns a number, 𝑛, such that min ≤ 𝑛 ≤ max.
-		return std::uniform_real_distribution{ min, max-1 }(rng);
+	static_assert(sizeof(Render) == 16);
+	
+	//Topology and render can be borrowed straight from a mapped save file, see Plane(path).
+	static_assert(std::is_trivially_copyable_v<Topology> && std::is_trivially_copyable_v<Render>);
+	MappableVector<Topology> topology{};
+	MappableVector<Render> render{};
+	std::vector<std::vector<Entity*>> occupants{}; //Grown on demand by occupantsOf(), up to the last tile anyone's stood on. Most tiles never have any.
+	std::vector<const char*> glyphs{ " " }; //Every glyph used by a tile here. Each is 4 bytes + null terminator at most, for utf8 astral plane characters.
+	std::shared_ptr<const void> backing{}; //Keeps whatever topology and render are borrowed from alive.
+	
+	struct Portal { //Where a portal link comes out, in another plane.
+		uint32_t plane;
+		TileIndex tile;
 	};
+	std::vector<Portal> portals{}; //Indexed by portal links.
+	
+	std::function<void(TileIndex tile, uint8_t edge)> onFrontier{}; //Replaces the frontier link at links[edge] of tile with a real one. Set by planes which are built lazily.
+	std::function<Tile(Portal const&)> onPortal{}; //Finds the tile a portal comes out at, loading its plane if need be. Set by the world.
+	
+	//Anything worked out from the links, such as a distance map, can note
+	//the epoch it was worked out at. If the epoch hasn't moved on since,
+	//it's still good. If it has, the tiles and rooms stamped later than that
+	//are the ones which changed. Adding tiles doesn't move the epoch, since
+	//nothing can reach them until they're linked to.
+	uint32_t epoch{ 0 }; //Moved on by every change to links.
+	std::vector<uint32_t> roomChangedAt{}; //By room id, the epoch a link of one of the room's tiles last changed. Grown on demand by touch().
+	
+	inline void touch(TileIndex tile) { //Note tile's links have changed, as of a new epoch.
+		topology[tile].changedAt = ++epoch;
+		const RoomId room{ render[tile].roomId };
+		if (room >= roomChangedAt.size()) roomChangedAt.resize(room + 1, 0);
+		roomChangedAt[room] = epoch;
+	}
+	inline uint32_t changedAt(RoomId room) const { return room < roomChangedAt.size() ? roomChangedAt[room] : 0; }
+	
+	TileArena() {};
+	explicit TileArena(size_t count) { //Create count unlinked tiles up front.
+		reserve(count);
+		for (size_t i = 0; i < count; i++) add();
+	}
+	
+	inline TileIndex add() {
+		assert(topology.size() < Link::maxTiles);
+		const auto index{ static_cast<TileIndex>(topology.size()) };
+		topology.emplace_back().changedAt = epoch;
+		render.emplace_back();
+		return index;
+	}
+	
+	inline std::vector<Entity*>& occupantsOf(TileIndex tile) { //For adding or taking away occupants.
+		if (tile >= occupants.size()) occupants.resize(tile + 1);
+		return occupants[tile];
+	}
+	inline std::vector<Entity*> const& occupantsAt(TileIndex tile) const { //For looking. Doesn't grow occupants.
+		static const std::vector<Entity*> none{};
+		return tile < occupants.size() ? occupants[tile] : none;
+	}
+	
+	uint8_t glyphIndex(const char* glyph); //Find a glyph in glyphs by its text, adding it if it's new.
+	
+	TileIndex append(TileArena& other); //Move another arena's tiles to the end of ours. Returns the offset their indices now start at.
+	TileIndex copy(TileArena const& other); //Copy another arena's tiles to the end of ours, leaving it as it was. Occupants aren't copied.
+	void renumber(std::span<const TileIndex> newIndexOf); //Move each tile to its new index, and repoint links to match.
+	
+	inline Tile operator[](TileIndex index) { return Tile{ this, index }; }
+	inline Tile operator[](TileIndex index) const { return Tile{ const_cast<TileArena*>(this), index }; } //Tiles are handles, they don't carry constness.
+	
+	inline void reserve(size_t count) {
+		topology.reserve(count);
+		render.reserve(count);
+	}
+	inline size_t size() const { return topology.size(); }
+	void reportMemory(MemoryReport& report) const; //Add what we hold to a report.
+	size_t bytes() const; //Memory held by the arrays, not counting what's in the occupant lists.
+};
+
+inline Tile Tile::follow(Link const& link) const {
+	if (!link || link.isFrontier()) return {};
+	if (link.isPortal()) {
+		assert(("Portal link in an arena which can't follow it.", arena->onPortal));
+		return arena->onPortal(arena->portals[link.tile()]);
+	}
+	return Tile{ arena, link.tile() };
+}
+
+inline Link (&Tile::links() const)[6] { return arena->topology[id].links; }
+inline bool& Tile::isOpaque() const { return arena->topology[id].isOpaque; }
+inline uint32_t Tile::changedAt() const { return arena->topology[id].changedAt; }
+inline RoomId& Tile::roomId() const { return arena->render[id].roomId; }
+inline const char* Tile::glyph() const { return arena->glyphs[arena->render[id].glyph]; }
+inline void Tile::setGlyph(const char* glyph) const { arena->render[id].glyph = arena->glyphIndex(glyph); }
+inline Color& Tile::bgColor() const { return arena->render[id].bgColor; }
+inline Color& Tile::fgColor() const { return arena->render[id].fgColor; }
+inline std::vector<Entity*>& Tile::occupants() const { return arena->occupantsOf(id); }
+inline std::vector<Entity*> const& Tile::occupantsHere() const { return arena->occupantsAt(id); }
 
-	std::vector<Tile*> tiles; //List of all tiles we created.
-	inline Tile* newOwnedTile() { return tiles.emplace_back(new Tile()); }
+
+class Plane {
+	//A plane is a collection of tiles, which are formed into rooms.
+	
+	inline static std::atomic<uint32_t> TotalPlanesCreated{ 0 }; //Planes may be made on any thread.
+	const uint32_t id{ 0 };
+
+	TileArena tiles; //All tiles we created. Freed in one go with the plane.
 
 	std::vector<Entity*> entities; //List of all entities we created. TODO: Track these as smart pointers, since we'll have many owners of indefinite lifetimes?
 	
 	struct RoomConnectionTile {
 		int8_t dir;
-		Tile* tile;
-		std::vector<Tile*> tiles;
+		TileIndex tile;
+		std::vector<TileIndex> tiles;
 
-		RoomConnectionTile(Tile* tile_, int8_t dir_);
+		RoomConnectionTile(Tile tile_, int8_t dir_);
 		
-		inline Tile* primary() { return tile; }
+		inline TileIndex primary() { return tile; }
 	};
 	
 	struct Room {
-		Tile* seed;
+		TileIndex seed;
 		std::vector<RoomConnectionTile> connections; //TODO: Make this a vector of vectors, so we can have multi-tile wide connections.
+		
+		void rebase(TileIndex offset); //Move the room's tile indices along, after its arena was appended to another.
+		void renumber(std::span<const TileIndex> newIndexOf); //Follow the room's tiles to their new indices, after its arena was renumbered.
+		size_t heldBytes() const; //Memory held by the room's connections.
 	};
 	std::vector<Room> rooms {};
-	static bool allRoomConnectionsAreFree(std::vector<Room> rooms);
-
-	Room genSquareRoom( //Can also generate cylindrical rooms and spherical rooms with wrapping, although the latter isn't very useful as it is inescapable.
-		const uint_fast8_t roomX, const uint_fast8_t roomY,
-		const bool wrapX = false, const bool wrapY = false,
-		const Color fg = Color{ 0,0,100 }, //These can't be const, VS says no.
-		const Color bg = Color{ 0,0,0 },
-		const uint_fast8_t possibleDoors = 0b1111 //Bitfield, up/right/bottom/left like in CSS.
-	);
-	
-	Room genConicalRoom(
-		const int height,
-		const Color fg = Color{ 0,0,100 }, //These can't be const, VS says no.
-		const Color bg = Color{ 0,0,0 },
-		const uint_least8_t possibleDoors = 0b111 //Bitfield, sides 1/2/3.
-	);
-
-	enum class genHallwayStyle { straight, zigZag, spiralCW, spiralCCW, irregular, COUNT };
-	Room genHallway(
-		const uint_fast8_t length,
-		const genHallwayStyle style
-	);
-	Room genHallway(
-		const uint_fast8_t length, const uint_fast8_t width,
-		const genHallwayStyle style
-	);
-	
-	void linkConnectionsWithHallway(auto& roomAConns, auto& roomBConns);
+	size_t roomBytes{ 0 }; //Memory held by all the rooms' connections, kept up to date as rooms are added and their doorways used, so bytes() needn't look through them.
+	DisjointSets roomComponents{}; //Which rooms have been linked up to which, by room index.
+	uint32_t roomOf(TileIndex tile) const; //Index of the room a room tile belongs to.
+	bool allRoomConnectionsAreFree(std::vector<Room> const& rooms);
+	
+	struct Frontier { //A doorway out of a lazily-built plane's room, which doesn't lead anywhere yet.
+		TileIndex tile;
+		uint32_t edge; //Only ever 0‥5, but a byte would leave padding to be saved with whatever was in it.
+		uint32_t stream; //What's past the doorway is built from this random number stream, so it doesn't matter when we get there.
+	};
+	MappableVector<Frontier> frontier{}; //Indexed by frontier links. Entries are left in place once built past.
+	
+	const Philox rng; //The plane's seed. Everything random about the plane is split off from this.
+	
+	class Builder {
+		//Builds rooms out of tiles, drawing on its own random number streams.
+		//Rooms don't touch each other until they're linked together, so they
+		//can be built on separate threads, each with a builder and arena.
+		
+		TileArena& tiles;
+		
+	public:
+		const RoomId roomId; //Given to the tiles of the room we build.
+		
+		enum Purpose : uint32_t { layout, glyphs, doors };
+		static constexpr uint32_t planeStream{ UINT32_MAX }; //Rooms are streams 0‥n, the plane's own builder takes the last.
+		
+		Philox rng; //Room shape, size, and colour.
+		Philox glyphRng; //Floor glyphs, drawn in bulk a room at a time.
+		
+		Builder(TileArena& tiles_, Philox const& planeRng, uint32_t stream, RoomId roomId_ = Tile::hallwayRoom)
+			: tiles(tiles_), roomId(roomId_), rng(planeRng.substream(stream, layout)), glyphRng(planeRng.substream(stream, glyphs)) {}
+		
+		inline int d(int max) {
+			//Returns a number, 𝑛, such that 0 ≤ 𝑛 < max.
+			return d(0, max);
+		};
+		inline int d(int min, int max) {
+			//Returns a number, 𝑛, such that min ≤ 𝑛 < max.
+			return min + static_cast<int>(rng.below(static_cast<uint32_t>(max - min)));
+		};
+		inline double d(double max) {
+			//Returns a number, 𝑛, such that min ≤ 𝑛 ≤ max.
+			return d(0., max);
+		};
+		inline double d(double min, double max) {
+			//Returns a number, 𝑛, such that min ≤ 𝑛 ≤ max.
+			return min + rng.unit() * (max - 1 - min);
+		};
+		
+		template<typename T>
+		void shuffle(std::vector<T>& items) {
+			//Fisher-Yates. std::shuffle's algorithm is up to the standard library, so it differs between platforms.
+			for (size_t i = items.size(); i > 1; i--) {
+				std::swap(items[i - 1], items[rng.below(static_cast<uint32_t>(i))]);
+			}
+		}
+		
+		void rollFloorGlyphs(TileIndex first, TileIndex end); //Give a run of new tiles random floor glyphs.
+		
+		inline TileIndex newOwnedTile() { return tiles.add(); }
+		
+		struct Prefab {
+			//A room's tiles, linked up but not yet coloured in. Rooms of the same
+			//shape and size are stamped out from one of these, so the linking
+			//(and checking of links) is only done once per shape.
+			enum class Shape : uint8_t { square, conical };
+			struct Key {
+				Shape shape;
+				uint8_t x, y{ 0 }; //Conical rooms only have a height, which goes in x.
+				bool wrapX{ false }, wrapY{ false };
+				auto operator<=>(Key const&) const = default;
+			};
+			struct Door {
+				TileIndex tile;
+				int8_t dir;
+				uint8_t bit; //Which bit of possibleDoors asks for this door.
+			};
+			
+			TileArena tiles{};
+			TileIndex seed{ Link::none };
+			std::vector<Door> doors{}; //Every door the room could have, in the order they're added to it.
+			
+			void genSquare(const uint_fast8_t roomX, const uint_fast8_t roomY, const bool wrapX, const bool wrapY);
+			void genConical(const int height);
+		};
+		static Prefab const& prefab(const Prefab::Key key); //Built on first use, then cached for good.
+		Room instantiate(Prefab const& prefab, const Color fg, const Color bg, const uint_fast8_t possibleDoors); //Copy a prefab into our arena, and roll its colours and glyphs.
+		
+		Room genRoom(); //A random room, of any type.
+		
+		Room genSquareRoom( //Can also generate cylindrical rooms and spherical rooms with wrapping, although the latter isn't very useful as it is inescapable.
+			const uint_fast8_t roomX, const uint_fast8_t roomY,
+			const bool wrapX = false, const bool wrapY = false,
+			const Color fg = Color{ 0,0,100 }, //These can't be const, VS says no.
+			const Color bg = Color{ 0,0,0 },
+			const uint_fast8_t possibleDoors = 0b1111 //Bitfield, up/right/bottom/left like in CSS.
+		);
+		
+		Room genConicalRoom(
+			const int height,
+			const Color fg = Color{ 0,0,100 }, //These can't be const, VS says no.
+			const Color bg = Color{ 0,0,0 },
+			const uint_least8_t possibleDoors = 0b111 //Bitfield, sides 1/2/3.
+		);
+
+		enum class genHallwayStyle { straight, zigZag, spiralCW, spiralCCW, irregular, COUNT };
+		struct HallwayRolls { //Drawn once per hallway, for the styles to pick from.
+			static constexpr int curveTypes{ 7 };
+			int zigZagRotation;
+			int zigZagType;
+			int curveIndex;
+		};
+		struct Straight; struct ZigZag; struct SpiralCW; struct SpiralCCW; struct Irregular; //Defined in places.cpp.
+		using HallwayStyles = std::tuple<Straight, ZigZag, SpiralCW, SpiralCCW, Irregular>; //In genHallwayStyle order.
+		
+		Room genHallway(
+			const uint_fast8_t length,
+			const genHallwayStyle style
+		);
+		Room genHallway(
+			const uint_fast8_t length, const uint_fast8_t width,
+			const genHallwayStyle style
+		);
+		template<typename Style>
+		Room genHallway(
+			const uint_fast8_t length, const uint_fast8_t width,
+			Style const& style
+		);
+	};
+	Builder builder; //For the plane's own tiles. Hallways and linking are done with this, after the rooms are built.
+	
+	void genRooms(int numRooms); //Build rooms in parallel, then move them into our arena.
+	void linkRoomsInClusters(uint32_t clusterSize); //Link each room to an earlier one, preferring ones in the same run of clusterSize rooms.
+	void linkStragglers(); //Link rooms cut off from the first to it, where there are doorways to do it with.
+	void linkConnectionsWithHallway(auto& roomAConns, auto& roomBConns, Builder& hallBuilder);
+	RoomConnectionTile takeConnection(std::vector<RoomConnectionTile>& connections); //Use up a room's last free doorway, keeping roomBytes up to date.
+	
+	explicit Plane(FileMapping save);
+	static uint64_t checkSave(FileMapping const& save); //Throw a LoadError unless everything in the save is in range. Returns the seed it was built from.
+	
+	std::vector<TileIndex> visitOrder(bool byDegree) const; //Every tile, breadth-first a room at a time from the starting tile, then any unreachable ones.
+	
+	void leaveFrontier(Room& room, uint32_t stream); //Turn a room's free doorways into frontier links, each leading to a room of its own.
+	void buildPastFrontier(TileIndex tile, uint8_t edge); //Build the hallway and room on the other side of a frontier link.
+	[[nodiscard]] bool verifyTopology(const char* after) const; //Complain loudly, and return false, if checkTopology finds anything.
 	
 
 public:
-	Plane(std::minstd_rand rng, int numRooms);
+	enum class Layout { //How rooms are linked up before the extra interlinks which make loops.
+		chain, //Each to the next, one long labyrinth.
+		tree, //Each to a random earlier room.
+		clusters, //Trees of a few rooms each, and those in a tree.
+	};
+	Plane(uint64_t seed, int numRooms, Layout layout = Layout::chain); //Build all the rooms up front.
+	explicit Plane(uint64_t seed); //Build one room, and the rest as they're reached. Each room is the same regardless of the order rooms are reached in.
+	explicit Plane(std::filesystem::path const& file); //Load a plane written by save(). The file is mapped, and its tiles used in place.
+	struct LoadError : std::runtime_error { //Thrown instead of loading a file which isn't a plane we wrote, or has been damaged.
+		using std::runtime_error::runtime_error;
+	};
 	~Plane();
+	
+	void save(std::ostream& out) const; //Entities owned by the plane are saved with it, and where they stand.
+	size_t bytes() const; //Memory held, approximately. Cheap enough to check every turn; memoryReport() has the rest.
+	MemoryReport memoryReport() const; //Memory held, broken down by what it's for.
+	
+	//Check every link in the plane is sound, on as many threads as there are
+	//cores. Unlike the asserts in Tile::link, this is done in release builds
+	//too, after each plane is built or loaded.
+	struct TopologyCheck {
+		size_t links{ 0 }; //How many were checked.
+		size_t badLinks{ 0 }; //Links with a bad direction, or to a tile, frontier or portal which isn't there.
+		size_t oneWayLinks{ 0 }; //Links to a tile, or frontier entry, which doesn't lead straight back.
+		size_t danglingDoors{ 0 }; //Spare doorways of rooms which have already been linked past, or which aren't on a tile.
+		TileIndex firstBadTile{ Link::none };
+		
+		explicit operator bool() const { return !badLinks && !oneWayLinks && !danglingDoors; } //True if nothing's wrong.
+		TopologyCheck& operator+=(TopologyCheck const& other);
+	};
+	TopologyCheck checkTopology() const;
+	
+	//Renumber tiles so ones near each other in the plane are near each other
+	//in memory, instead of in the order they were generated. Must be done
+	//before portals are made into the plane, or anything else holds on to
+	//its tiles.
+	enum class TileOrder {
+		breadthFirst, //Outwards from the starting tile, a room or hallway at a time so each stays in one piece.
+		reverseCuthillMcKee, //The same, but visiting less-linked tiles first, and then reversed.
+	};
+	void reorder(TileOrder order);
+	
+	inline size_t tileCount() const { return tiles.size(); }
+	inline size_t roomCount() const { return rooms.size(); }
+	inline uint32_t topologyEpoch() const { return tiles.epoch; } //See TileArena::epoch.
+	inline uint32_t roomChangedAt(uint32_t room) const { return tiles.changedAt(Tile::firstRoom + room); } //By room index. Hallways aren't rooms.
+	inline size_t roomComponentCount() const { return roomComponents.setCount(); } //Groups of rooms which can't reach each other. One, if the plane is connected.
+	inline size_t largestRoomComponent() const { return roomComponents.largestSetSize(); } //Rooms.
 
 	friend std::ostream& operator<<(std::ostream& os, Plane const& plane);
+	friend std::ostream& operator<<(std::ostream& os, TopologyCheck const& check);
+	friend class World;
+	friend class DistanceMap;
+	friend class RoomGraph;
 
-	Tile* getStartingTile();
+	Tile getStartingTile();
 	const std::vector<Room>& getRooms();
 	
 	template<typename T=Entity, class ...Args>
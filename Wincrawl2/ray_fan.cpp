@@ -0,0 +1,279 @@
+//The rays a view traces out from its centre, merged into one tree.
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+#include "ray_fan.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define RAY_FAN_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET(isa) //MSVC allows any instruction set's intrinsics anywhere.
+#else
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+
+std::vector<RayFan::Ray> RayFan::raysFor(int width, int height) {
+	std::vector<Ray> rays{};
+	const double centreX = width / 2, centreY = height / 2;
+
+	//TODO: Rework this so it traces the lines around true (integer) lines first, then the final true lines.
+	for (auto offset : { 0.25, 0.75, 0.5, 0.0 }) {
+		for (double x = 0; x < width; x += width - 1) {
+			for (double y = 0; y < height - 1; y++) {
+				rays.push_back({ centreX, centreY, x, y + offset });
+			}
+		}
+		for (double x = 0; x < width - 1; x++) {
+			for (double y = 0; y < height; y += height - 1) {
+				rays.push_back({ centreX, centreY, x + offset, y });
+			}
+		}
+	}
+
+	//Trace the final diagonal line to the 1-2 corner.
+	rays.push_back({ centreX, centreY, width - 1.0, height - 1.0 });
+	return rays;
+}
+
+RayFan::RayFan(int width, int height) : width_(width), height_(height) {
+	assert(("View too big to fit a ray's cells in a node.", width <= UINT16_MAX && height <= UINT16_MAX));
+
+	//Build the tree with links to children first, since rays can add to
+	//any part of it. Each cell's children are the ways on from it.
+	struct Branch {
+		uint16_t x, y, depth;
+		uint8_t direction;
+		RayId lastRay;
+		uint32_t children[4]{ 0, 0, 0, 0 }; //By direction. 0 for none, as the root is never anyone's child.
+	};
+	std::vector<Branch> branches{ { static_cast<uint16_t>(width / 2), static_cast<uint16_t>(height / 2), 0, 0, 0 } };
+	RayId ray{ 0 };
+	for (Ray const& line : raysFor(width, height)) {
+		ray++;
+		uint32_t at{ 0 };
+		branches[at].lastRay = ray;
+		traverseGrid(line.sx, line.sy, line.dx, line.dy, [&](int x, int y, int direction) {
+			uint32_t child{ branches[at].children[direction] };
+			if (!child) {
+				child = static_cast<uint32_t>(branches.size());
+				branches[at].children[direction] = child;
+				const uint16_t depth = branches[at].depth + 1;
+				branches.push_back({ static_cast<uint16_t>(x), static_cast<uint16_t>(y), depth, static_cast<uint8_t>(direction), 0 });
+				if (depth > maxDepth) maxDepth = depth;
+			}
+			at = child;
+			branches[at].lastRay = ray;
+			return true;
+		});
+	}
+
+	//Then lay it out depth first, so it can be walked without them.
+	nodes.reserve(branches.size());
+	std::vector<uint32_t> stack{ 0 }; //Branches, then nodes to close off once their subtree's laid out.
+	constexpr uint32_t closing{ 1u << 31 };
+	while (!stack.empty()) {
+		const uint32_t top{ stack.back() };
+		stack.pop_back();
+		if (top & closing) {
+			nodes[top & ~closing].subtreeEnd = static_cast<uint32_t>(nodes.size());
+			continue;
+		}
+
+		const Branch& branch{ branches[top] };
+		stack.push_back(static_cast<uint32_t>(nodes.size()) | closing);
+		nodes.push_back({ branch.x, branch.y, branch.depth, branch.direction, 0, branch.lastRay });
+		for (int direction = 3; direction >= 0; direction--) {
+			if (branch.children[direction]) stack.push_back(branch.children[direction]);
+		}
+	}
+	
+	//Lay it out again breadth first, for stepping a ring at a time.
+	rings.reserve(nodes.size());
+	rings.push_back({ nodes[0].x, nodes[0].y, 0, 0, 0, nodes[0].lastRay, 0 });
+	for (uint32_t at = 0; at < rings.size(); at++) {
+		const uint32_t parent{ rings[at].node };
+		rings[at].firstChild = static_cast<uint32_t>(rings.size());
+		for (uint32_t child = parent + 1; child < nodes[parent].subtreeEnd; child = nodes[child].subtreeEnd) {
+			const uint8_t turn = (nodes[child].direction - nodes[parent].direction) & 3;
+			rings.push_back({ nodes[child].x, nodes[child].y, turn, 0, 0, nodes[child].lastRay, child });
+			rings[at].childCount++;
+		}
+	}
+	
+	//Split it for threads where it first fans out enough to keep them busy.
+	std::vector<size_t> widths(maxDepth + 1);
+	for (Node const& node : nodes) widths[node.depth]++;
+	for (uint16_t depth = 1; depth <= maxDepth; depth++) {
+		if (widths[depth] >= minBranches) {
+			splitDepth = depth;
+			break;
+		}
+	}
+}
+
+
+const char* RayFan::kernelNames[]{ "scalar", "sse4.1", "avx2" };
+
+RayFan::Kernel RayFan::bestKernel() {
+	static const Kernel best{ []{
+		#ifdef RAY_FAN_X86
+			#ifdef _MSC_VER
+				int info[4];
+				__cpuid(info, 1);
+				const bool hasSse41{ (info[2] >> 19 & 1) != 0 };
+				const bool hasAvx{ (info[2] >> 27 & 3) == 3 && (_xgetbv(0) & 6) == 6 }; //The CPU has it, and the OS saves ymm registers.
+				__cpuidex(info, 7, 0);
+				const bool hasAvx2{ hasAvx && (info[1] >> 5 & 1) != 0 };
+			#else
+				const bool hasSse41{ __builtin_cpu_supports("sse4.1") != 0 };
+				const bool hasAvx2{ __builtin_cpu_supports("avx2") != 0 };
+			#endif
+			if (hasAvx2) return Kernel::avx2;
+			if (hasSse41) return Kernel::sse41;
+		#endif
+		return Kernel::scalar;
+	}() };
+	return best;
+}
+
+
+//The vector kernels read the arena's topology as 32-bit words, eight to a
+//tile, and a link's edge out of Tile::transport as a word as well.
+namespace {
+	constexpr int wordsPerTile{ sizeof(TileArena::Topology) / 4 };
+	constexpr int opaqueWord{ offsetof(TileArena::Topology, isOpaque) / 4 }; //isOpaque is its low byte.
+	static_assert(offsetof(TileArena::Topology, links) == 0 && sizeof(Link) == 4);
+	static_assert(wordsPerTile == 8 && offsetof(TileArena::Topology, isOpaque) % 4 == 0);
+	
+	alignas(32) constexpr std::array<int32_t, 24> transportEdges{ []{ //By the edge come in by * 4 + the turn.
+		std::array<int32_t, 24> edges{};
+		for (int dir = 0; dir < 6; dir++) {
+			for (int turn = 0; turn < 4; turn++) edges[dir * 4 + turn] = Tile::transport[dir][turn].edge;
+		}
+		return edges;
+	}() };
+}
+
+void RayFan::stepLanes(Lanes& lanes, TileArena::Topology const* topology, Kernel kernel) {
+	assert(("Can't step lanes with a kernel this CPU can't run.", kernel <= bestKernel()));
+	size_t done{ 0 };
+	switch (kernel) {
+		case Kernel::avx2: done = stepLanesAvx2(lanes, topology); break;
+		case Kernel::sse41: done = stepLanesSse41(lanes, topology); break;
+		default: break;
+	}
+	stepLanesScalar(lanes, topology, done);
+}
+
+void RayFan::stepLanesScalar(Lanes& lanes, TileArena::Topology const* topology, size_t first) {
+	for (size_t lane = first; lane < lanes.size(); lane++) {
+		const Link link{ topology[lanes.tile[lane]].links[transportEdges[lanes.dir[lane] * 4 + lanes.turn[lane]]] };
+		lanes.toTile[lane] = link.tile();
+		lanes.toDir[lane] = link.dir();
+		if (!link) lanes.status[lane] = offEdge;
+		else if (link.isFrontier() || link.isPortal()) lanes.status[lane] = deferred;
+		else lanes.status[lane] = topology[link.tile()].isOpaque ? stopped : clear;
+	}
+}
+
+#ifdef RAY_FAN_X86
+
+//SSE4.1 has no gather, so load each lane's word by itself.
+TARGET("sse4.1") static inline __m128i gatherWords(const void* base, __m128i index) {
+	int32_t words[4];
+	for (int lane = 0; lane < 4; lane++) {
+		std::memcpy(&words[lane], static_cast<const char*>(base) + 4 * static_cast<size_t>(static_cast<uint32_t>(_mm_cvtsi128_si32(index))), 4);
+		index = _mm_srli_si128(index, 4);
+	}
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(words));
+}
+
+TARGET("sse4.1") size_t RayFan::stepLanesSse41(Lanes& lanes, TileArena::Topology const* topology) {
+	const size_t count{ lanes.size() & ~size_t{ 3 } };
+	const __m128i zero{ _mm_setzero_si128() };
+	for (size_t lane = 0; lane < count; lane += 4) {
+		const __m128i tile{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(&lanes.tile[lane])) };
+		const __m128i dir{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(&lanes.dir[lane])) };
+		const __m128i turn{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(&lanes.turn[lane])) };
+		
+		const __m128i edge{ gatherWords(transportEdges.data(), _mm_add_epi32(_mm_slli_epi32(dir, 2), turn)) };
+		const __m128i link{ gatherWords(topology, _mm_add_epi32(_mm_slli_epi32(tile, 3), edge)) };
+		const __m128i linkDir{ _mm_and_si128(link, _mm_set1_epi32(Link::dirMask)) };
+		const __m128i isOffEdge{ _mm_cmpeq_epi32(link, zero) };
+		const __m128i isDeferred{ _mm_or_si128( //Frontiers, and portals, which have the sign bit.
+			_mm_cmpeq_epi32(linkDir, _mm_set1_epi32(Link::frontierDir)),
+			_mm_cmpgt_epi32(zero, link)
+		) };
+		const __m128i isStopped{ _mm_or_si128(isOffEdge, isDeferred) };
+		const __m128i to{ _mm_sub_epi32(_mm_srli_epi32(link, Link::dirBits), _mm_set1_epi32(1)) };
+		
+		//Lanes which didn't go anywhere look at the first tile instead, which is always there.
+		const __m128i opaqueAt{ _mm_add_epi32(_mm_andnot_si128(isStopped, _mm_slli_epi32(to, 3)), _mm_set1_epi32(opaqueWord)) };
+		const __m128i isOpaque{ _mm_andnot_si128(
+			_mm_or_si128(isStopped, _mm_cmpeq_epi32(_mm_and_si128(gatherWords(topology, opaqueAt), _mm_set1_epi32(0xff)), zero)),
+			_mm_set1_epi32(-1)
+		) };
+		
+		__m128i status{ _mm_and_si128(isOpaque, _mm_set1_epi32(stopped)) };
+		status = _mm_blendv_epi8(status, _mm_set1_epi32(offEdge), isOffEdge);
+		status = _mm_blendv_epi8(status, _mm_set1_epi32(deferred), isDeferred);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&lanes.toTile[lane]), to);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&lanes.toDir[lane]), linkDir);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&lanes.status[lane]), status);
+	}
+	return count;
+}
+
+TARGET("avx2") size_t RayFan::stepLanesAvx2(Lanes& lanes, TileArena::Topology const* topology) {
+	const int* const words{ reinterpret_cast<const int*>(topology) };
+	const size_t count{ lanes.size() & ~size_t{ 7 } };
+	const __m256i zero{ _mm256_setzero_si256() };
+	for (size_t lane = 0; lane < count; lane += 8) {
+		const __m256i tile{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&lanes.tile[lane])) };
+		const __m256i dir{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&lanes.dir[lane])) };
+		const __m256i turn{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&lanes.turn[lane])) };
+		
+		const __m256i edge{ _mm256_i32gather_epi32(transportEdges.data(), _mm256_add_epi32(_mm256_slli_epi32(dir, 2), turn), 4) };
+		const __m256i link{ _mm256_i32gather_epi32(words, _mm256_add_epi32(_mm256_slli_epi32(tile, 3), edge), 4) };
+		const __m256i linkDir{ _mm256_and_si256(link, _mm256_set1_epi32(Link::dirMask)) };
+		const __m256i isOffEdge{ _mm256_cmpeq_epi32(link, zero) };
+		const __m256i isDeferred{ _mm256_or_si256( //Frontiers, and portals, which have the sign bit.
+			_mm256_cmpeq_epi32(linkDir, _mm256_set1_epi32(Link::frontierDir)),
+			_mm256_cmpgt_epi32(zero, link)
+		) };
+		const __m256i isStopped{ _mm256_or_si256(isOffEdge, isDeferred) };
+		const __m256i to{ _mm256_sub_epi32(_mm256_srli_epi32(link, Link::dirBits), _mm256_set1_epi32(1)) };
+		
+		//Only lanes which went somewhere look at where they went.
+		const __m256i opaqueWords{ _mm256_mask_i32gather_epi32(
+			zero, words,
+			_mm256_add_epi32(_mm256_slli_epi32(to, 3), _mm256_set1_epi32(opaqueWord)),
+			_mm256_andnot_si256(isStopped, _mm256_set1_epi32(-1)), 4
+		) };
+		const __m256i isOpaque{ _mm256_andnot_si256(
+			_mm256_or_si256(isStopped, _mm256_cmpeq_epi32(_mm256_and_si256(opaqueWords, _mm256_set1_epi32(0xff)), zero)),
+			_mm256_set1_epi32(-1)
+		) };
+		
+		__m256i status{ _mm256_and_si256(isOpaque, _mm256_set1_epi32(stopped)) };
+		status = _mm256_blendv_epi8(status, _mm256_set1_epi32(offEdge), isOffEdge);
+		status = _mm256_blendv_epi8(status, _mm256_set1_epi32(deferred), isDeferred);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&lanes.toTile[lane]), to);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&lanes.toDir[lane]), linkDir);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&lanes.status[lane]), status);
+	}
+	return count;
+}
+
+#else
+
+size_t RayFan::stepLanesSse41(Lanes&, TileArena::Topology const*) { return 0; }
+size_t RayFan::stepLanesAvx2(Lanes&, TileArena::Topology const*) { return 0; }
+
+#endif
@@ -0,0 +1,287 @@
+//The rays a view traces out from its centre, merged into one tree.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ranges>
+#include <thread>
+#include <vector>
+
+#include "places.hpp"
+#include "raytracer.hpp"
+
+class RayFan {
+	//A view traces a few thousand rays out from its centre, and those
+	//going the same way share their first several cells. As a tree of the
+	//moves they make, with shared beginnings merged, each tile link is
+	//walked once however many rays pass through it, and everything past
+	//a wall is skipped in one go.
+	//
+	//The same tile can be reached by different rays, and on a non-
+	//euclidean plane they don't always agree what's there. When traced one
+	//by one, the last ray to reach a cell set it. Each node keeps the last
+	//ray through it, so the result doesn't depend on which way the tree is
+	//walked, nor on how many threads walk it.
+
+public:
+	struct Ray { double sx, sy, dx, dy; };
+	static std::vector<Ray> raysFor(int width, int height); //What's traced for a view of this size, in order.
+
+	typedef uint32_t RayId; //Numbered from 1, in the order raysFor lists them.
+
+	enum class Kernel { scalar, sse41, avx2, COUNT }; //Ways to step rays together, narrowest first. See traceBatched.
+	static const char* kernelNames[static_cast<int>(Kernel::COUNT)];
+
+private:
+	struct Node { //A cell a ray steps into. Nodes are in depth-first order, so a subtree follows its root.
+		uint16_t x, y;
+		uint16_t depth; //Steps from the centre. The centre itself is 0.
+		uint8_t direction; //The way the step was taken on screen, as for RayWalker::step.
+		uint32_t subtreeEnd; //One past the last node in this one's subtree.
+		RayId lastRay; //Of those through here.
+	};
+	std::vector<Node> nodes{}; //The first is the centre, the root of the tree.
+	int width_{ 0 }, height_{ 0 };
+	uint16_t maxDepth{ 0 };
+	
+	//Threads are handed the subtrees rooted this far out, where there are
+	//enough of them to go round. The trunk, nearer in, is walked first on
+	//the calling thread. 0 if the tree's too small to be worth it.
+	uint16_t splitDepth{ 0 };
+	static constexpr size_t minBranches{ 64 };
+	
+	struct Branch { //A subtree to walk, and the walker its root is stepped into from.
+		uint32_t node;
+		RayWalker from;
+	};
+	
+	//Walk nodes first‥last, given walkers for the depths above first's.
+	//If shared, other threads may be reading the plane too, so steps which
+	//would build or load anything are put off, and their subtrees added to
+	//deferred instead.
+	template<bool isShared, typename Function>
+	void walk(uint32_t first, uint32_t last, std::vector<RayWalker>& walkers, Function&& onTile, std::vector<Branch>* deferred) const;
+	
+	//The same tree breadth first, for traceBatched, so each ring of cells
+	//out from the centre is together. A node's children follow on from
+	//those of the node before it.
+	struct RingNode {
+		uint16_t x, y;
+		uint8_t turn; //From the way the ray was going on screen to the way it steps here. See RayWalker::step.
+		uint8_t childCount;
+		uint32_t firstChild;
+		RayId lastRay;
+		uint32_t node; //The same node, depth first.
+	};
+	std::vector<RingNode> rings{};
+	
+	struct Lanes { //Steps taken together, one per node, in columns so several can be loaded at once.
+		std::vector<uint32_t> node{}, parent{}; //Stepped into, and from, in rings.
+		std::vector<uint32_t> tile{}, dir{}, turn{}; //The parent's tile, the edge of it the ray came in by, and which way it turns from there.
+		std::vector<uint32_t> toTile{}, toDir{}, status{}; //Where the step comes out, and what's there. Filled in by stepLanes.
+		inline size_t size() const { return node.size(); }
+	};
+	enum LaneStatus : uint32_t { clear, stopped, offEdge, deferred }; //Can be seen past, can't, stepped into nothing, or would build or load something.
+	
+	//Step every lane. The kernels each do as many as they can a vector at a
+	//time and return how many that was, and the scalar kernel does the rest.
+	static void stepLanes(Lanes& lanes, TileArena::Topology const* topology, Kernel kernel);
+	static void stepLanesScalar(Lanes& lanes, TileArena::Topology const* topology, size_t first);
+	static size_t stepLanesSse41(Lanes& lanes, TileArena::Topology const* topology);
+	static size_t stepLanesAvx2(Lanes& lanes, TileArena::Topology const* topology);
+
+public:
+	RayFan() {};
+	RayFan(int width, int height);
+
+	inline int width() const { return width_; }
+	inline int height() const { return height_; }
+	inline size_t stepCount() const { return nodes.empty() ? 0 : nodes.size() - 1; } //Tile links walked per trace, if nothing's in the way.
+
+	//Walk the tree out from start, calling onTile(tile, x, y, lastRay) for
+	//each cell stepped into, and stopping along each branch at the first
+	//tile which can't be seen past. Returns how many steps that took.
+	//With more than one worker, the branches are walked on threads of their
+	//own, and onTile is called for what they saw once they're all done.
+	//Frontiers and portals they came to are then built past and followed
+	//one at a time, in the order a single thread would have. onTile is
+	//only ever called from the calling thread.
+	template<typename Function>
+	size_t trace(Tile start, int dir, Function&& onTile, size_t workerCount = 1) const;
+	
+	static Kernel bestKernel(); //The widest this CPU can run.
+	
+	//As trace on one thread, but stepping every ray out from one ring of
+	//cells to the next together, in lanes of as many as the kernel does at
+	//once. Where the rays go is looked up with gathers from the arena's
+	//topology, and which stop with masks, rather than walking tile by tile.
+	//Frontiers and portals are put off, and walked past in tree order at
+	//the end, as in trace. Returns how many steps that took.
+	//Only reliably faster over open ground. In rooms, walls stop most rays
+	//within a few cells, and setting each ring's lanes up costs about what
+	//stepping them saves, so View sticks to trace. raytracing-bench has both.
+	template<typename Function>
+	size_t traceBatched(Tile start, int dir, Function&& onTile, Kernel kernel = bestKernel()) const;
+};
+
+
+template<bool isShared, typename Function>
+void RayFan::walk(uint32_t first, uint32_t last, std::vector<RayWalker>& walkers, Function&& onTile, std::vector<Branch>* deferred) const {
+	for (uint32_t index = first; index < last;) {
+		const Node& node{ nodes[index] };
+		if constexpr (isShared) {
+			const Link& link{ walkers[node.depth - 1].linkTowards(node.direction) };
+			if (link.isFrontier() || link.isPortal()) {
+				deferred->push_back({ index, walkers[node.depth - 1] });
+				index = node.subtreeEnd;
+				continue;
+			}
+		}
+		RayWalker& walker{ walkers[node.depth] = walkers[node.depth - 1] };
+		const bool isClear{ walker.step(node.direction) };
+		onTile(walker.loc, node.x, node.y, node.lastRay);
+		index = isClear ? index + 1 : node.subtreeEnd;
+	}
+}
+
+template<typename Function>
+size_t RayFan::trace(Tile start, int dir, Function&& onTile, size_t workerCount) const {
+	std::vector<RayWalker> walkers(maxDepth + 1); //By depth. The walker at each depth is a step on from the one before it.
+	walkers[0] = { start, dir };
+	size_t steps{ 0 };
+	const auto countingOnTile{ [&](Tile tile, int x, int y, RayId ray) {
+		steps++;
+		onTile(tile, x, y, ray);
+	} };
+	if (workerCount <= 1 || !splitDepth) {
+		walk<false>(1, static_cast<uint32_t>(nodes.size()), walkers, countingOnTile, nullptr);
+		return steps;
+	}
+	
+	//Walk the trunk, noting where each branch starts. Nothing's built yet,
+	//even here, so that whatever is is built in the same order as when
+	//walked on one thread, and is there for the rays after it.
+	std::vector<Branch> branches{}, waiting{};
+	for (uint32_t index = 1; index < nodes.size();) {
+		const Node& node{ nodes[index] };
+		if (node.depth == splitDepth) {
+			branches.push_back({ index, walkers[node.depth - 1] });
+			index = node.subtreeEnd;
+			continue;
+		}
+		const Link& link{ walkers[node.depth - 1].linkTowards(node.direction) };
+		if (link.isFrontier() || link.isPortal()) {
+			waiting.push_back({ index, walkers[node.depth - 1] });
+			index = node.subtreeEnd;
+			continue;
+		}
+		RayWalker& walker{ walkers[node.depth] = walkers[node.depth - 1] };
+		const bool isClear{ walker.step(node.direction) };
+		countingOnTile(walker.loc, node.x, node.y, node.lastRay);
+		index = isClear ? index + 1 : node.subtreeEnd;
+	}
+	
+	//Then the branches, each worker taking the next one left when it's
+	//done with its last. Nothing changes the plane until they're all
+	//done, so they can all read it at once.
+	struct Seen {
+		Tile tile;
+		uint16_t x, y;
+		RayId ray;
+	};
+	workerCount = std::min(workerCount, branches.size());
+	std::vector<std::vector<Seen>> seen(workerCount);
+	std::vector<std::vector<Branch>> deferred(workerCount);
+	std::atomic<size_t> nextBranch{ 0 };
+	{
+		std::vector<std::jthread> workers{};
+		for (size_t worker : std::views::iota(size_t{ 0 }, workerCount)) {
+			workers.emplace_back([&, worker]{
+				std::vector<RayWalker> ownWalkers(maxDepth + 1);
+				const auto note{ [&](Tile tile, int x, int y, RayId ray) {
+					seen[worker].push_back({ tile, static_cast<uint16_t>(x), static_cast<uint16_t>(y), ray });
+				} };
+				for (size_t branch; (branch = nextBranch++) < branches.size();) {
+					const uint32_t root{ branches[branch].node };
+					ownWalkers[nodes[root].depth - 1] = branches[branch].from;
+					walk<true>(root, nodes[root].subtreeEnd, ownWalkers, note, &deferred[worker]);
+				}
+			});
+		}
+	} //Joined here.
+	for (auto const& tiles : seen) {
+		for (Seen const& tile : tiles) countingOnTile(tile.tile, tile.x, tile.y, tile.ray);
+	}
+	
+	//Last, what couldn't be got past without changing the plane. In tree
+	//order, so rooms are built and planes loaded in the same order as when
+	//walked on one thread.
+	for (auto const& branches : deferred) waiting.insert(waiting.end(), branches.begin(), branches.end());
+	std::ranges::sort(waiting, {}, &Branch::node);
+	for (Branch const& branch : waiting) {
+		walkers[nodes[branch.node].depth - 1] = branch.from;
+		walk<false>(branch.node, nodes[branch.node].subtreeEnd, walkers, countingOnTile, nullptr);
+	}
+	return steps;
+}
+
+template<typename Function>
+size_t RayFan::traceBatched(Tile start, int dir, Function&& onTile, Kernel kernel) const {
+	size_t steps{ 0 };
+	const auto countingOnTile{ [&](Tile tile, int x, int y, RayId ray) {
+		steps++;
+		onTile(tile, x, y, ray);
+	} };
+	TileArena* const arena{ start.getArena() };
+	
+	//The rays still going, by where in rings they've got to and the tile they're
+	//in there. Every lane is in start's arena, since portals are put off.
+	std::vector<uint32_t> liveNode{ 0 }, liveTile{ start.index() }, liveDir{ static_cast<uint32_t>(dir) };
+	Lanes lanes{};
+	std::vector<Branch> waiting{};
+	while (!liveNode.empty()) {
+		for (auto* column : { &lanes.node, &lanes.parent, &lanes.tile, &lanes.dir, &lanes.turn }) column->clear();
+		for (size_t live = 0; live < liveNode.size(); live++) {
+			const RingNode& parent{ rings[liveNode[live]] };
+			for (uint32_t child = parent.firstChild; child < parent.firstChild + parent.childCount; child++) {
+				lanes.node.push_back(child);
+				lanes.parent.push_back(liveNode[live]);
+				lanes.tile.push_back(liveTile[live]);
+				lanes.dir.push_back(liveDir[live]);
+				lanes.turn.push_back(rings[child].turn);
+			}
+		}
+		for (auto* column : { &lanes.toTile, &lanes.toDir, &lanes.status }) column->resize(lanes.size());
+		stepLanes(lanes, arena->topology.data(), kernel);
+		
+		liveNode.clear(); liveTile.clear(); liveDir.clear();
+		for (size_t lane = 0; lane < lanes.size(); lane++) {
+			const RingNode& node{ rings[lanes.node[lane]] };
+			switch (lanes.status[lane]) {
+			case deferred:
+				waiting.push_back({ node.node, { { arena, lanes.tile[lane] }, static_cast<int>(lanes.dir[lane]), nodes[rings[lanes.parent[lane]].node].direction } });
+				break;
+			case offEdge:
+				countingOnTile({}, node.x, node.y, node.lastRay);
+				break;
+			case stopped:
+				countingOnTile({ arena, lanes.toTile[lane] }, node.x, node.y, node.lastRay);
+				break;
+			default:
+				countingOnTile({ arena, lanes.toTile[lane] }, node.x, node.y, node.lastRay);
+				liveNode.push_back(lanes.node[lane]);
+				liveTile.push_back(lanes.toTile[lane]);
+				liveDir.push_back(lanes.toDir[lane]);
+			}
+		}
+	}
+	
+	std::ranges::sort(waiting, {}, &Branch::node);
+	std::vector<RayWalker> walkers(maxDepth + 1);
+	for (Branch const& branch : waiting) {
+		walkers[nodes[branch.node].depth - 1] = branch.from;
+		walk<false>(branch.node, nodes[branch.node].subtreeEnd, walkers, countingOnTile, nullptr);
+	}
+	return steps;
+}
@@ -1,55 +1,171 @@
 #pragma once
 
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <functional>
 #include <vector>
 
 #include "places.hpp"
 #include "ecs.hpp"
 
-class Raytracer {
-	//Since our geometry has no external location or orientation, we must "walk" it to
-	//find out what we've got. Our RayWalker translates absolute movement of the raytrace
-	//function into relative movement through the world.
-	//It notes down what it's found in the field.
+struct RaytracerVisitor {
+	//What a raytracer tells about the tiles it passes through. Visitors
+	//derive from this and hide whichever of these they want to hear about.
+	//Being a type parameter of the raytracer rather than a std::function, a
+	//visitor's calls are made directly, and inlined into the stepping loop.
+	inline void onEachTile(Tile, int, int) {} //On each tile the ray passes through.
+	inline void onLastTile(Tile, int, int) {} //On the final tile the ray passes through. May not be the target tile, might have hit something.
+	inline void onTargetTile(Tile, int, int) {} //On the target tile the ray was directed at.
+};
+
+//So what happens here is that there's two lobes to the brain of this
+//raytracer, mainly due to some implementation mismatch around the tiles
+//and the ray math. Basically, the raytracer works on a north-facing
+//cartesian grid, we have a directed cyclic graph to traverse, and com-
+//bining both in one function is prohibitively complex. So traverseGrid
+//works out the cells on screen a ray passes through, and a RayWalker
+//follows along in the plane.
+
+
+struct RayWalker {
+	//Translates absolute movement on screen into relative movement through the world.
 	
-	Tile* loc{ nullptr }; //location
-	int dir{ 0 }; //direction
+	Tile loc{}; //location
+	int dir{ 0 }; //direction, the edge of loc we came in by
+	int lastDirectionIndex{ 0 }; //The way we last moved on screen.
 	
-	int lastX{ 0 };
-	int lastY{ 0 };
-	int lastDirectionIndex{ 0 };
+	//Step into the tile in a direction on screen, 0-3 for +y, +x, -y, -x.
+	//Returns whether the ray can carry on from there.
+	inline bool step(int directionIndex) {
+		//Enter the room in the relative direction from us.
+		auto movement = loc->getNextTile(dir, directionIndex - lastDirectionIndex);
+		loc = loc.follow(*movement);
+		dir = movement->dir();
+		lastDirectionIndex = directionIndex;
+		return loc && !loc->isOpaque();
+	}
 	
-	typedef std::vector<std::vector<Tile*>>* Field;
-	Field field{};
+	//The link step would take, without building past it if it's a frontier.
+	inline Link const& linkTowards(int directionIndex) const {
+		return loc.links()[Tile::transport[dir][(directionIndex - lastDirectionIndex) & 3].edge];
+	}
+};
+
+
+struct TraversalAxis { //One axis of a line being traced, in fixed point so the quarter-cell targets View traces to are exact.
+	static constexpr int fixedShift{ 8 }; //Fractional bits.
+	static constexpr int64_t cell{ 1 << fixedShift }, halfCell{ cell / 2 };
 	
-	void reset(int x, int y);
+	int at, target, step; //Cells.
+	int64_t length; //Of the line.
+	int64_t toEdge; //From the start of the line to the next cell edge it crosses on this axis.
 	
-	bool moveTo(int x, int y);
+	static int64_t toFixed(double coord) { return std::llround(std::ldexp(coord, fixedShift)); }
+	static int cellOf(int64_t coord) { return static_cast<int>((coord + halfCell) >> fixedShift); }
+	TraversalAxis(double from_, double to_) {
+		const int64_t from{ toFixed(from_) }, to{ toFixed(to_) };
+		at = cellOf(from);
+		target = cellOf(to);
+		step = to < from ? -1 : +1;
+		length = std::abs(to - from);
+		toEdge = std::abs((static_cast<int64_t>(at) << fixedShift) + step * halfCell - from);
+	}
+};
+
+//Walk the cells a line crosses, from the centre of the cell at s to the
+//point d. A cell covers its coordinate ±½, and each is entered once, by
+//one of its four edges, in the order the line crosses into them. (Amanatides
+//and Woo, "A Fast Voxel Traversal Algorithm for Ray Tracing", and the
+//playtechs.blogspot.com write-up of it for grids.) Where the line goes
+//exactly through a corner, it steps along x first. There's no rounding
+//along the way, so it never overshoots or doubles back.
+//onStep(x, y, directionIndex) is called for each cell after the first, and
+//can return false to stop there. Returns whether the end was reached.
+template<typename Function>
+bool traverseGrid(double sx, double sy, double dx, double dy, Function&& onStep) {
+	TraversalAxis x{ sx, dx }, y{ sy, dy };
 	
-	using callback = std::function<void(Tile*, int rayX, int rayY)>;
-	struct RaytracerCallbacks { //Callbacks, fired:…
-		const callback onEachTile { [](...){} }; //…on each tile the ray passes through.
-		const callback onLastTile { [](...){} }; //…on the final tile the ray passes through. May not be the target tile, might have hit something.
-		const callback onTargetTile { [](...){} }; //…on the target tile the ray was directed at.
-	};
+	while (x.at != x.target || y.at != y.target) {
+		//The line crosses x's next edge first if x.toEdge / x.length is less.
+		//Each axis has as many edges left to cross as cells to go, so once
+		//one's there, the rest are the other's.
+		int directionIndex;
+		if (y.at == y.target || (x.at != x.target && x.toEdge * y.length <= y.toEdge * x.length)) {
+			x.at += x.step;
+			x.toEdge += TraversalAxis::cell;
+			directionIndex = x.step > 0 ? 1 : 3;
+		}
+		else {
+			y.at += y.step;
+			y.toEdge += TraversalAxis::cell;
+			directionIndex = y.step > 0 ? 0 : 2;
+		}
+		
+		if (!onStep(x.at, y.at, directionIndex)) return false;
+	}
+	return true;
+}
+
+
+template<typename Visitor>
+class BasicRaytracer {
+	//Since our geometry has no external location or orientation, we must "walk" it to
+	//find out what we've got. Our RayWalker translates absolute movement of the raytrace
+	//function into relative movement through the world.
+	//It notes down what it's found in the field.
 	
 public:
-	Tile* startingTile{ nullptr };
+	Tile startingTile{};
 	int startingDir{ 0 };
 	
-	const callback onEachTile;
-	const callback onLastTile;
-	const callback onTargetTile;
+	Visitor visitor;
 	
-	Raytracer(const Raytracer::RaytracerCallbacks&);
+	explicit BasicRaytracer(Visitor visitor_ = {}) : visitor(std::move(visitor_)) {}
 	
-	inline void setOriginTile(Tile* tile, int dir) {
+	inline void setOriginTile(Tile tile, int dir) {
 		startingTile = tile; startingDir = dir;
 	};
 	
 	void trace(double sx, double sy, double dx, double dy);
+};
+
+
+struct RaytracerCallbacks { //A visitor which can be changed at runtime, at the cost of an indirect call each tile.
+	using callback = std::function<void(Tile, int rayX, int rayY)>;
+	callback onEachTile{ [](...){} };
+	callback onLastTile{ [](...){} };
+	callback onTargetTile{ [](...){} };
+};
+auto operator<<(std::ostream& os, const RaytracerCallbacks& params) -> std::ostream&; //Debug.
+
+class Raytracer : public BasicRaytracer<RaytracerCallbacks> {
+	//For when the visitor isn't known until runtime, such as when debugging.
+
+public:
+	using callback = RaytracerCallbacks::callback;
+	using BasicRaytracer::BasicRaytracer;
 	
 	//Debug.
 	friend auto operator<<(std::ostream& os, const Raytracer& params) -> std::ostream&;
-	friend auto operator<<(std::ostream& os, const Raytracer::RaytracerCallbacks& params) -> std::ostream&;
-};
\ No newline at end of file
+};
+
+
+
+template<typename Visitor>
+void BasicRaytracer<Visitor>::trace(double sx, double sy, double dx, double dy) {
+	RayWalker walker{ startingTile, startingDir };
+	int lastX{ static_cast<int>(std::floor(sx + 0.5)) }, lastY{ static_cast<int>(std::floor(sy + 0.5)) };
+	
+	const bool isReached{ traverseGrid(sx, sy, dx, dy, [&](int x, int y, int directionIndex) {
+		const bool isClear{ walker.step(directionIndex) };
+		lastX = x;
+		lastY = y;
+		visitor.onEachTile(walker.loc, x, y);
+		return isClear;
+	}) };
+	
+	visitor.onLastTile(walker.loc, lastX, lastY);
+	if (isReached) visitor.onTargetTile(walker.loc, lastX, lastY);
+}
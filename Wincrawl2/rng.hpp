@@ -0,0 +1,170 @@
+//Random number generation which comes out the same on every platform.
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <span>
+
+class Philox {
+	//Philox4x32-10, a counter-based generator. (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3".)
+	//Each output is a pure function of (seed, stream, purpose, position), so
+	//there is no state to carry between rooms - any stream can be split off
+	//and any position in it sought in O(1). Unlike std::minstd_rand with the
+	//std:: distributions, the numbers don't depend on the standard library.
+
+public:
+	using result_type = uint32_t;
+	using Block = std::array<uint32_t, 4>;
+
+	static constexpr Block block(Block counter, uint64_t key) {
+		//Ten rounds of the Philox bijection, giving four outputs per counter value.
+		constexpr uint32_t M0{ 0xD2511F53 }, M1{ 0xCD9E8D57 }; //Multipliers.
+		constexpr uint32_t W0{ 0x9E3779B9 }, W1{ 0xBB67AE85 }; //Key schedule, the golden ratio and √3-1.
+		uint32_t k0{ static_cast<uint32_t>(key) }, k1{ static_cast<uint32_t>(key >> 32) };
+		for (int round = 0; round < 10; round++) {
+			const uint64_t p0{ uint64_t{ M0 } * counter[0] };
+			const uint64_t p1{ uint64_t{ M1 } * counter[2] };
+			counter = {
+				static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ k0,
+				static_cast<uint32_t>(p1),
+				static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ k1,
+				static_cast<uint32_t>(p0),
+			};
+			k0 += W0; k1 += W1;
+		}
+		return counter;
+	}
+
+	constexpr Philox(uint64_t seed_, uint32_t stream_ = 0, uint32_t purpose_ = 0)
+		: seed(seed_), streamId(stream_), purposeId(purpose_) {}
+
+	//Another generator with the same seed, but an independent sequence.
+	constexpr Philox substream(uint32_t stream_, uint32_t purpose_) const { return { seed, stream_, purpose_ }; }
+
+	constexpr uint64_t getSeed() const { return seed; }
+	constexpr uint32_t stream() const { return streamId; }
+	constexpr uint32_t purpose() const { return purposeId; }
+	constexpr uint64_t tell() const { return position; } //How many numbers have been drawn.
+	constexpr void seek(uint64_t position_) { position = position_; }
+
+	constexpr result_type operator()() {
+		if (position / 4 != cachedBlock) {
+			cachedBlock = position / 4;
+			cache = blockAt(cachedBlock);
+		}
+		return cache[position++ % 4];
+	}
+
+	constexpr void fill(std::span<uint32_t> out) {
+		//Draw many numbers at once. Equivalent to calling () once per element.
+		size_t i{ 0 };
+		for (; i < out.size() && position % 4; i++) out[i] = (*this)();
+		for (; i + 4 <= out.size(); i += 4, position += 4) {
+			const Block outputs{ blockAt(position / 4) };
+			for (size_t j = 0; j < 4; j++) out[i + j] = outputs[j];
+		}
+		for (; i < out.size(); i++) out[i] = (*this)();
+	}
+
+	//Returns a number, 𝑛, such that 0 ≤ 𝑛 < range. Lemire's multiply-shift, with rejection so it's unbiased.
+	constexpr uint32_t below(uint32_t range) {
+		uint64_t product{ uint64_t{ (*this)() } * range };
+		if (static_cast<uint32_t>(product) < range) {
+			const uint32_t threshold{ static_cast<uint32_t>(-range) % range };
+			while (static_cast<uint32_t>(product) < threshold) {
+				product = uint64_t{ (*this)() } * range;
+			}
+		}
+		return static_cast<uint32_t>(product >> 32);
+	}
+
+	//Scale an already-drawn number to 0 ≤ 𝑛 < range, for batches from fill(). Exact for powers of two, very slightly biased otherwise.
+	static constexpr uint32_t scale(uint32_t roll, uint32_t range) {
+		return static_cast<uint32_t>((uint64_t{ roll } * range) >> 32);
+	}
+
+	//Returns a number, 𝑛, such that 0 ≤ 𝑛 < 1, with 53 bits of precision.
+	constexpr double unit() {
+		const uint64_t hi{ (*this)() }, lo{ (*this)() };
+		return static_cast<double>((hi << 21) | (lo >> 11)) * 0x1p-53;
+	}
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return UINT32_MAX; }
+
+private:
+	uint64_t seed;
+	uint32_t streamId;
+	uint32_t purposeId;
+	uint64_t position{ 0 };
+
+	uint64_t cachedBlock{ UINT64_MAX };
+	Block cache{};
+
+	constexpr Block blockAt(uint64_t index) const {
+		return block({
+			static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32),
+			streamId, purposeId,
+		}, seed);
+	}
+};
+
+//Known-answer tests from the Random123 distribution, kat_vectors.
+static_assert(Philox::block({ 0, 0, 0, 0 }, 0) == Philox::Block{ 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 });
+static_assert(Philox::block(
+	{ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }, 0x299f31d0'a4093822
+) == Philox::Block{ 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 });
+
+
+class Permutation {
+	//A shuffle of 0‥size-1 which takes no memory, to visit things in a random
+	//order without making a list of them. A keyed Feistel network is a
+	//bijection on the next power of four up, and values which land outside
+	//of the range are put through again until they're back in it.
+	//(Black and Rogaway, "Ciphers with Arbitrary Finite Domains".) That's
+	//under four times on average. Each round's function is a Philox block.
+	
+	static constexpr uint32_t rounds{ 4 };
+	
+	uint32_t size;
+	uint64_t key;
+	uint32_t halfBits{ 1 };
+	
+	constexpr uint32_t encrypt(uint32_t value) const {
+		const uint32_t halfMask{ (1u << halfBits) - 1 };
+		uint32_t left{ value >> halfBits }, right{ value & halfMask };
+		for (uint32_t round = 0; round < rounds; round++) {
+			const uint32_t mixed{ left ^ (Philox::block({ right, round, 0, 0 }, key)[0] & halfMask) };
+			left = right;
+			right = mixed;
+		}
+		return left << halfBits | right;
+	}
+	
+public:
+	constexpr Permutation(uint32_t size_, uint64_t key_) : size(size_), key(key_) {
+		while (halfBits < 16 && uint64_t{ 1 } << (2 * halfBits) < size) halfBits++;
+	}
+	
+	constexpr uint32_t operator()(uint32_t index) const { //Where index is shuffled to.
+		assert(index < size);
+		do index = encrypt(index); while (index >= size);
+		return index;
+	}
+};
+
+static_assert([]{
+	//Every index comes out exactly once, for sizes on and off powers of four.
+	for (uint32_t size : { 1u, 2u, 4u, 5u, 16u, 100u }) {
+		const Permutation shuffle{ size, 0x5EED };
+		uint64_t seen{ 0 }, seenHigh{ 0 };
+		for (uint32_t i = 0; i < size; i++) {
+			const uint32_t j{ shuffle(i) };
+			uint64_t& bits{ j < 64 ? seen : seenHigh };
+			if (j >= size || bits & uint64_t{ 1 } << (j % 64)) return false;
+			bits |= uint64_t{ 1 } << (j % 64);
+		}
+	}
+	return true;
+}());
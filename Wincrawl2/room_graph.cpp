@@ -0,0 +1,206 @@
+//Finding paths across a plane, a room at a time.
+#include <algorithm>
+#include <cassert>
+
+#include "room_graph.hpp"
+
+
+bool RoomGraph::isWalkable(TileIndex tile, Link const& link) const {
+	return link && !link.isFrontier() && !link.isPortal()
+		&& tiles.render[link.tile()].roomId == tiles.render[tile].roomId;
+}
+
+bool RoomGraph::isDoorway(TileIndex tile) const {
+	return std::ranges::any_of(tiles.topology[tile].links, [&](Link const& link) {
+		return link && !link.isFrontier() && !link.isPortal() && !isWalkable(tile, link);
+	});
+}
+
+std::optional<RoomGraph::NodeId> RoomGraph::nodeAt(TileIndex tile) const {
+	const auto node{ std::ranges::lower_bound(nodes.begin(), nodes.end() - 1, tile, {}, &Node::tile) };
+	if (node == nodes.end() - 1 || node->tile != tile) return std::nullopt;
+	return static_cast<NodeId>(node - nodes.begin());
+}
+
+RoomGraph::Visits RoomGraph::searchRegion(TileIndex start) const {
+	Visits visits{ { start, Visit{ Link::none, 0, 0 } } };
+	std::vector<TileIndex> queue{ start };
+	for (size_t next = 0; next < queue.size(); next++) {
+		const TileIndex tile{ queue[next] };
+		const uint32_t steps{ visits.at(tile).steps + 1 };
+		auto& links{ tiles.topology[tile].links };
+		for (uint8_t edge = 0; edge < std::size(links); edge++) {
+			if (!isWalkable(tile, links[edge])) continue;
+			if (visits.try_emplace(links[edge].tile(), Visit{ tile, edge, steps }).second) {
+				queue.push_back(links[edge].tile());
+			}
+		}
+	}
+	return visits;
+}
+
+void RoomGraph::tracePath(Visits const& visits, TileIndex from, TileIndex to, Path& path) const {
+	const size_t start{ path.size() };
+	for (TileIndex tile = to; tile != from;) {
+		const Visit& visit{ visits.at(tile) };
+		path.push_back(visit.edge);
+		tile = visit.from;
+	}
+	std::reverse(path.begin() + start, path.end());
+}
+
+RoomGraph::RoomGraph(Plane const& plane) : tiles(plane.tiles), epoch(plane.tiles.epoch) {
+	//Doorways, in tile order so they can be looked up by tile.
+	for (TileIndex tile = 0; tile < tiles.size(); tile++) {
+		if (isDoorway(tile)) nodes.push_back({ tile, 0 });
+	}
+
+	//Each doorway leads a step across to the doorways it's linked to, and
+	//however many steps it is to each of the others in its region. There
+	//are a lot of doorways to search from, so rather than searchRegion's
+	//hash map, steps are counted in one array over the whole plane, and
+	//only the tiles touched are cleared after each search.
+	std::vector<uint32_t> steps(tiles.size(), unreached);
+	std::vector<TileIndex> queue{};
+	const auto nodeCount{ static_cast<NodeId>(nodes.size()) };
+	nodes.push_back({ Link::none, 0 });
+	for (NodeId node = 0; node < nodeCount; node++) {
+		nodes[node].firstEdge = static_cast<uint32_t>(edges.size());
+		const TileIndex tile{ nodes[node].tile };
+
+		for (auto& link : tiles.topology[tile].links) {
+			if (link && !link.isFrontier() && !link.isPortal() && !isWalkable(tile, link)) {
+				const auto across{ nodeAt(link.tile()) };
+				assert(("Doorway links to a tile which doesn't link back.", across));
+				edges.push_back({ *across, 1 });
+			}
+		}
+
+		queue.assign(1, tile);
+		steps[tile] = 0;
+		for (size_t next = 0; next < queue.size(); next++) {
+			const TileIndex reached{ queue[next] };
+			if (reached != tile && isDoorway(reached)) edges.push_back({ *nodeAt(reached), steps[reached] });
+			for (auto& link : tiles.topology[reached].links) {
+				if (isWalkable(reached, link) && steps[link.tile()] == unreached) {
+					steps[link.tile()] = steps[reached] + 1;
+					queue.push_back(link.tile());
+				}
+			}
+		}
+		for (TileIndex reached : queue) steps[reached] = unreached;
+
+		//Sorted, so paths come out the same however the doorways were found.
+		std::sort(edges.begin() + nodes[node].firstEdge, edges.end(), [](Edge const& a, Edge const& b) {
+			return a.to != b.to ? a.to < b.to : a.steps < b.steps;
+		});
+	}
+	nodes.back().firstEdge = static_cast<uint32_t>(edges.size());
+}
+
+std::optional<RoomGraph::Path> RoomGraph::findPath(Tile from, Tile to) const {
+	if (from == to) return Path{};
+	
+	//The ends of the path are found tile by tile, within their regions.
+	//Searching out from to gives the number of steps to it from each
+	//doorway of its region, since links always lead back the way they came.
+	const Visits fromVisits{ searchRegion(from.index()) };
+	const Visits toVisits{ searchRegion(to.index()) };
+	
+	uint32_t bestSteps{ unreached };
+	NodeId meeting{ noNode }; //Where the best path found so far crosses from one search to the other, if it leaves from's region.
+	if (const auto direct{ fromVisits.find(to.index()) }; direct != fromVisits.end()) {
+		bestSteps = direct->second.steps;
+	}
+	
+	//Then the doorways in between, searching out from both ends at once.
+	//Steps between doorways are the same both ways, so both searches use the
+	//same edges. Planes are well interlinked, so a search from one end
+	//reaches most of the plane before it gets to the other, but two meet
+	//halfway having seen far less.
+	Search forward{ *this, fromVisits }, backward{ *this, toVisits };
+	const auto meet{ [&](NodeId node) {
+		if (forward.steps[node] == unreached || backward.steps[node] == unreached) return;
+		if (forward.steps[node] + backward.steps[node] < bestSteps) {
+			bestSteps = forward.steps[node] + backward.steps[node];
+			meeting = node;
+		}
+	} };
+	for (NodeId node : backward.reached) meet(node);
+	while (!forward.queue.empty() && !backward.queue.empty()) {
+		if (forward.queue.top().first + backward.queue.top().first >= bestSteps) break; //Nothing shorter is left to find.
+		Search& search{ forward.queue.top().first <= backward.queue.top().first ? forward : backward };
+		search.step(*this, meet);
+	}
+	if (bestSteps == unreached) return std::nullopt;
+	
+	//Now work out the tiles between the doorways on the way.
+	Path path{};
+	path.reserve(bestSteps);
+	if (meeting == noNode) {
+		tracePath(fromVisits, from.index(), to.index(), path);
+		return path;
+	}
+	
+	std::vector<NodeId> route{};
+	for (NodeId node = meeting; node != noNode; node = forward.cameFrom[node]) route.push_back(node);
+	std::reverse(route.begin(), route.end());
+	for (NodeId node = backward.cameFrom[meeting]; node != noNode; node = backward.cameFrom[node]) route.push_back(node);
+	
+	tracePath(fromVisits, from.index(), nodes[route.front()].tile, path);
+	for (size_t leg = 1; leg < route.size(); leg++) {
+		const TileIndex a{ nodes[route[leg - 1]].tile }, b{ nodes[route[leg]].tile };
+		auto& links{ tiles.topology[a].links };
+		const auto across{ std::ranges::find_if(links, [&](Link const& link) {
+			return link && !link.isFrontier() && !link.isPortal() && !isWalkable(a, link) && link.tile() == b;
+		}) };
+		if (across != std::end(links)) {
+			path.push_back(static_cast<uint8_t>(across - std::begin(links)));
+		}
+		else {
+			tracePath(searchRegion(a), a, b, path);
+		}
+	}
+	
+	//The last leg was searched from to, so walk it backwards from the doorway.
+	for (TileIndex tile = nodes[route.back()].tile; tile != to.index();) {
+		const Visit& visit{ toVisits.at(tile) };
+		path.push_back(tiles.topology[visit.from].links[visit.edge].dir());
+		tile = visit.from;
+	}
+	
+	assert(("Path came out a different length than it was costed at.", path.size() == bestSteps));
+	return path;
+}
+
+RoomGraph::Search::Search(RoomGraph const& graph, Visits const& start)
+	: steps(graph.nodes.size() - 1, unreached), cameFrom(graph.nodes.size() - 1, noNode)
+{
+	for (auto& [tile, visit] : start) {
+		if (!graph.isDoorway(tile)) continue;
+		const NodeId node{ *graph.nodeAt(tile) };
+		steps[node] = visit.steps;
+		queue.push({ visit.steps, node });
+		reached.push_back(node);
+	}
+}
+
+void RoomGraph::Search::step(RoomGraph const& graph, auto&& onReach) {
+	const auto [nodeSteps, node] { queue.top() };
+	queue.pop();
+	if (nodeSteps > steps[node]) return; //Got here a shorter way since.
+	
+	for (uint32_t edge = graph.nodes[node].firstEdge; edge < graph.nodes[node + 1].firstEdge; edge++) {
+		const auto [to, edgeSteps] { graph.edges[edge] };
+		if (nodeSteps + edgeSteps < steps[to]) {
+			steps[to] = nodeSteps + edgeSteps;
+			cameFrom[to] = node;
+			queue.push({ steps[to], to });
+			onReach(to);
+		}
+	}
+}
+
+size_t RoomGraph::bytes() const {
+	return sizeof(RoomGraph) + nodes.capacity() * sizeof(Node) + edges.capacity() * sizeof(Edge);
+}
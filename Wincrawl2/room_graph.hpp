@@ -0,0 +1,81 @@
+//Finding paths across a plane, a room at a time.
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include "places.hpp"
+
+class RoomGraph {
+	//Rooms and hallways only meet at their doorways, so to get across a
+	//plane we only need to know how the doorways connect. This is a graph of
+	//them, with how many steps it takes to get from each doorway to the
+	//others of its room or hallway. A path is found over the doorways first, and only
+	//then worked out tile by tile, in the rooms along the way. Paths across a
+	//plane cost on the order of its rooms, not its tiles.
+	//
+	//A region is a connected group of tiles with the same room id: a room,
+	//or a hallway. Its doorways are the tiles with a link into another
+	//region. Frontier and portal links count as walls, like in DistanceMap.
+	//The graph is built from the plane as it is, so it has to be built again
+	//once a lazy plane has grown, or the plane has been reordered, or any
+	//other links have changed. isCurrent() says whether they have.
+
+public:
+	typedef std::vector<uint8_t> Path; //The edge to leave each tile by, from the start.
+
+private:
+	TileArena const& tiles;
+
+	typedef uint32_t NodeId;
+	struct Node {
+		TileIndex tile; //A doorway.
+		uint32_t firstEdge; //Edges leaving this node are edges[firstEdge] to edges[next node's firstEdge].
+	};
+	struct Edge {
+		NodeId to;
+		uint32_t steps;
+	};
+	std::vector<Node> nodes{}; //Sorted by tile, with one extra at the end to close off the last one's edges.
+	std::vector<Edge> edges{};
+	const uint32_t epoch; //The plane's topology epoch when we were built.
+
+	struct Visit { //A tile reached by searching a region.
+		TileIndex from;
+		uint8_t edge; //Left from by.
+		uint32_t steps;
+	};
+	typedef std::unordered_map<TileIndex, Visit> Visits;
+	
+	static constexpr NodeId noNode{ UINT32_MAX };
+	static constexpr uint32_t unreached{ UINT32_MAX };
+	struct Search { //Dijkstra's, over the doorways, out from the doorways of a region.
+		std::vector<uint32_t> steps; //By node.
+		std::vector<NodeId> cameFrom;
+		typedef std::pair<uint32_t, NodeId> Queued;
+		std::priority_queue<Queued, std::vector<Queued>, std::greater<Queued>> queue{};
+		std::vector<NodeId> reached{}; //The doorways started from.
+		
+		Search(RoomGraph const& graph, Visits const& start);
+		void step(RoomGraph const& graph, auto&& onReach); //Visit the nearest doorway queued, calling onReach(node) for each it gets nearer to.
+	};
+
+	bool isWalkable(TileIndex tile, Link const& link) const; //Within the region of tile.
+	bool isDoorway(TileIndex tile) const; //Quicker than looking it up.
+	std::optional<NodeId> nodeAt(TileIndex tile) const;
+	Visits searchRegion(TileIndex start) const; //Breadth-first, over all of start's region.
+	void tracePath(Visits const& visits, TileIndex from, TileIndex to, Path& path) const; //Append the way there.
+
+public:
+	explicit RoomGraph(Plane const& plane);
+
+	std::optional<Path> findPath(Tile from, Tile to) const; //A shortest path, if there is one.
+
+	bool isCurrent() const { return epoch == tiles.epoch; }
+	size_t doorwayCount() const { return nodes.size() - 1; }
+	size_t bytes() const; //Memory held.
+};
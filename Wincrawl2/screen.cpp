@@ -298,4 +298,40 @@ void MainScreen::renderPromptPanel(const char* input) {
 			writeCell(neutralForeground, neutralBackground, "", promptPanel.rect()->y, x);
 		}
 	}
-}
\ No newline at end of file
+}
+
+
+
+/**
+ * Draw the debug page, one line of its text per row.
+ */
+void DebugScreen::render(const char* input) {
+	const auto& rect{ *main.rect() };
+	
+	std::stringstream text{};
+	describe(text);
+	std::vector<std::string> newLines{};
+	for (std::string line; std::getline(text, line);) {
+		line.resize(std::min(line.size(), static_cast<size_t>(rect.w)));
+		newLines.push_back(line);
+	}
+	if (newLines != lines) {
+		dirty = true; //Cells only point at their text, so a line changed in place wouldn't be redrawn otherwise.
+	}
+	lines = std::move(newLines);
+	
+	//As in CenteredTextPanel, each line goes in its first cell and the rest of it is zero-width padding.
+	for (auto y : iota(0, rect.h)) {
+		for (auto x : iota(0, rect.w)) {
+			const std::string* line{ static_cast<size_t>(y) < lines.size() ? &lines[y] : nullptr };
+			const char* character{
+				!line ? " " :
+				!x ? line->c_str() :
+				static_cast<size_t>(x) < line->size() ? "" : " "
+			};
+			writeCell(neutralForeground, neutralBackground, character, rect.y + y, rect.x + x);
+		}
+	}
+	
+	Screen::render(input);
+}
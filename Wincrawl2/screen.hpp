@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <iostream>
 #include <string>
 #include <string_view>
@@ -188,12 +189,17 @@ public:
 class DebugScreen : public Screen {
 	ScrollablePanel main { true };
 	
+	std::function<void(std::ostream&)> describe; ///< Writes out the text of the page, fresh each render.
+	std::vector<std::string> lines {}; ///< The text on screen. Cells point into it, so it's kept until the next render.
+	
 public:
 	void setSize(size_t x, size_t y) {
 		Screen::setSize(x, y);
 		main.setSize(x, y);
 	}
-	inline DebugScreen(Triggers triggers) : Screen(triggers) {
+	inline DebugScreen(Triggers triggers, std::function<void(std::ostream&)> describe) : Screen(triggers), describe(describe) {
 		setSize(110, 25);
 	}
+	
+	void render(const char* input) override;
 };
\ No newline at end of file
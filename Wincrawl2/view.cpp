@@ -1,14 +1,16 @@
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <limits>
 #include <sstream>
+#include <thread>
 
 #include "color.hpp"
 #include "seq.hpp"
 #include "view.hpp"
 
 
-View::View(uint8_t width, uint8_t height, Tile* pointOfView)
+View::View(uint8_t width, uint8_t height, Tile pointOfView)
 	: loc(pointOfView)
 {
 	viewSize[0] = width;
@@ -17,24 +19,19 @@ View::View(uint8_t width, uint8_t height, Tile* pointOfView)
 	grid.reserve(width);
 	for (int x = 0; x < viewSize[0]; x++) {
 		grid.emplace_back()
-			.assign(height, nullptr);
+			.assign(height, Tile{});
 	}
 	
 	//A few tiles are needed as placeholders by the rendering code.
-	hiddenTile.roomId = 1;
-	hiddenTile.glyph = "░";
-	emptyTile.roomId = 2;
-	emptyTile.glyph = "▓";
-	
-	//raytracer.onEachTile = [&](auto loc, auto x, auto y){
-	//	grid[x][y] = loc ? loc : &emptyTile;
-	//};
+	hiddenTile->roomId() = Tile::hiddenRoom;
+	hiddenTile->setGlyph("░");
+	emptyTile->roomId() = Tile::emptyRoom;
+	emptyTile->setGlyph("▓");
 }
 
 
 void View::render(std::unique_ptr<TextCellSubGrid> target) {
 	assert(loc); //If no location is defined, fail.
-	raytracer.setOriginTile(loc, rot);
 	
 	viewSize[0] = (*target)[0].size(), viewSize[1] = target->size();
 	
@@ -44,32 +41,32 @@ void View::render(std::unique_ptr<TextCellSubGrid> target) {
 	grid.reserve(viewSize[0]);
 	for (int x = 0; x < viewSize[0]; x++) {
 		grid.emplace_back()
-			.assign(viewSize[1], nullptr);
+			.assign(viewSize[1], Tile{});
 	}
 	
 	//First, all our tiles are hidden.
 	for (int x = 0; x < viewSize[0]; x++) {
 		for (int y = 0; y < viewSize[1]; y++) {
-			grid[x][y] = &hiddenTile;
+			grid[x][y] = hiddenTile;
 		}
 	}
+	gridRay.assign(viewSize[0], std::vector<RayFan::RayId>(viewSize[1], 0));
 	
-	//TODO: Rework this so it traces the lines around true (integer) lines first, then the final true lines.
-	for (auto offset : std::vector<double>{0.25, 0.75, 0.5, 0}) {
-		for (double x = 0; x < viewSize[0]; x += viewSize[0] - 1) {
-			for (double y = 0; y < viewSize[1]-1; y++) {
-				raytracer.trace(viewloc[0], viewloc[1], x, y + offset);
-			}
-		}
-		for (double x = 0; x < viewSize[0]-1; x++) {
-			for (double y = 0; y < viewSize[1]; y += viewSize[1] - 1) {
-				raytracer.trace(viewloc[0], viewloc[1], x + offset, y);
-			}
-		}
+	if (fan.width() != viewSize[0] || fan.height() != viewSize[1]) {
+		fan = RayFan{ viewSize[0], viewSize[1] };
 	}
-	
-	//Trace the final diagonal line to the 1-2 corner, which doesn't get covered otherwise.
-	raytracer.trace(viewloc[0], viewloc[1], viewSize[0], viewSize[1]);
+	//Rays are traced on as many threads as there's work for. Whichever got
+	//there, the last ray to reach a cell sets it, so it comes out the same.
+	constexpr size_t minStepsPerWorker{ 1 << 14 }; //A few hundred µs of tracing. Below this, starting a thread costs more than it saves.
+	const size_t workerCount{ std::clamp<size_t>(
+		lastSteps / minStepsPerWorker,
+		1, std::max(1u, std::thread::hardware_concurrency())
+	) };
+	lastSteps = fan.trace(loc, rot, [&](Tile tile, int x, int y, RayFan::RayId ray) {
+		if (ray < gridRay[x][y]) return;
+		gridRay[x][y] = ray;
+		grid[x][y] = tile ? tile : emptyTile;
+	}, workerCount);
 	
 	//We don't ever trace the center tile, just those around it.
 	grid[viewloc[0]][viewloc[1]] = loc;
@@ -79,11 +76,11 @@ void View::render(std::unique_ptr<TextCellSubGrid> target) {
 			TextCell& tile { (*target)[y][x] };
 			
 			//Print entity on tile.
-			for (auto entity : grid[x][y]->occupants) {
+			for (auto entity : grid[x][y]->occupantsHere()) {
 				auto paint = entity->dispatch(Event::GetRendered{});
 				if (paint.glyph) {
 					tile.character = reinterpret_cast<const char*>(paint.glyph);
-					tile.background = grid[x][y]->bgColor; //Just ignore the background color of objects for now, need a "none" or "alpha" variant for colors.
+					tile.background = grid[x][y]->bgColor(); //Just ignore the background color of objects for now, need a "none" or "alpha" variant for colors.
 					tile.foreground = paint.fgColor;
 					
 					goto nextTile;
@@ -91,9 +88,9 @@ void View::render(std::unique_ptr<TextCellSubGrid> target) {
 			}
 			
 			//If there are no entities on the tile, print tile itself.
-			tile.character = reinterpret_cast<const char*>(grid[x][y]->glyph);
-			tile.background = grid[x][y]->bgColor;
-			tile.foreground = grid[x][y]->fgColor;
+			tile.character = reinterpret_cast<const char*>(grid[x][y]->glyph());
+			tile.background = grid[x][y]->bgColor();
+			tile.foreground = grid[x][y]->fgColor();
 			
 			nextTile: continue;
 		}
@@ -101,9 +98,38 @@ void View::render(std::unique_ptr<TextCellSubGrid> target) {
 }
 
 
+//The view sees its tile as if it had come in by edge rot, at the top of the screen, heading down.
+//(This is the raytracer's starting frame too.) So a direction on screen is a turn relative to that.
+static constexpr int screenTurn(int direction) {
+	return (2 - direction) & 3;
+}
+
+static_assert(
+	[]{
+		for (int rot = 0; rot < 4; rot++) {
+			for (int direction = -3; direction <= 3; direction++) {
+				const auto step{ Tile::transport[rot][screenTurn(direction)] };
+				
+				//What View::turn used to do.
+				if (step.edge != (direction + rot + 4) % 4) return false;
+				
+				//What View::move used to do.
+				if (direction < 0) continue;
+				for (int arrival = 0; arrival < 6; arrival++) {
+					if (((Tile::oppositeEdge[arrival] + step.rotation) & 3) != (rot + (Tile::oppositeEdge[arrival] - (direction + rot)) + 4) % 4) return false;
+				}
+			}
+		}
+		return true;
+	}(),
+	"View movement via Tile::transport must match the original rotation arithmetic."
+);
+
+
 void View::move(int direction) {
-	auto link {loc->getNextTile((direction + rot + 4) % 4) };
-	if (!link->tile()) return;
+	const auto step{ Tile::transport[rot][screenTurn(direction)] };
+	auto link { loc->getNextTile(step.edge) };
+	if (!*link) return;
 
 	//To get the new view rotation, consider the following example
 	//of travelling between two tiles in direction 1.
@@ -125,24 +151,23 @@ void View::move(int direction) {
 	//aligned by adding the delta between the two directions to
 	//our rotation. Delta is 1-2=-1, so rotation is 1+-1=0.
 	//
-	//Thus, the following formula breaks down like so:
-	//Inner-most brackets: Tile direction left in.
-	//Up one level: Rotatinoal delta calculation.
-	//Rest of formula: Add rotational delta to current rotation.
+	//Since the direction we left by is our rotation plus the
+	//direction we moved in, the rotation cancels out. What's left
+	//depends only on which way we turned, and the transport table
+	//has it ready for us: the new rotation is the opposite of the
+	//arrival direction, plus the step's rotation.
 	
 	//Hack: Drag the first entity found on a tile to the tile we're moving to. This should always be our player, plus we have no other entities for now. We should just render the entity's tile.
-	Entity* player { loc->occupants.back() };
-	loc->occupants.pop_back();
+	Entity* player { loc->occupants().back() };
+	loc->occupants().pop_back();
 	
-	rot = (rot + (
-		Tile::oppositeEdge[link->dir()] - (direction + rot)
-	) + 4) % 4;
-	loc = link->tile();
+	rot = (Tile::oppositeEdge[link->dir()] + step.rotation) & 3;
+	loc = loc.follow(*link);
 	
-	loc->occupants.push_back(player);
+	loc->occupants().push_back(player);
 }
 
 
 void View::turn(int delta) {
-	rot = (delta + rot + 4) % 4;
+	rot = Tile::transport[rot][screenTurn(delta)].edge;
 }
\ No newline at end of file
@@ -6,7 +6,7 @@
 
 #include "ecs.hpp"
 #include "places.hpp"
-#include "raytracer.hpp"
+#include "ray_fan.hpp"
 #include "textbits.hpp"
 
 class View {
@@ -14,25 +14,20 @@ class View {
 	//Because our tiles are non-euclidean, you may see a tile multiple times.
 
 	uint8_t viewSize[2];
-	std::vector<std::vector<Tile*>> grid;
-	inline static Tile hiddenTile{};
-	inline static Tile emptyTile{};
+	std::vector<std::vector<Tile>> grid;
+	std::vector<std::vector<RayFan::RayId>> gridRay; //The ray which set each cell of the grid, so the last to get there wins.
+	inline static TileArena placeholderTiles{ 2 };
+	inline static Tile hiddenTile{ placeholderTiles[0] };
+	inline static Tile emptyTile{ placeholderTiles[1] };
 	
-	Raytracer raytracer{{
-		.onEachTile = [&](auto loc, auto x, auto y) {
-			grid[x][y] = loc ? loc : &emptyTile;
-		}
-	}};
-	
-	//Can't copy View without rebinding raytracer's callbacks here from the original object. It will crash horribly when the view is resized then.
-	View (View&) = delete;
-	View operator=(View&) = delete;
+	RayFan fan{}; //Made again when the view changes size.
+	size_t lastSteps{ 0 }; //Taken tracing the last frame. The next is likely much the same, so it picks how many threads to trace with.
 
 public:
-	Tile* loc;
+	Tile loc;
 	int rot{ 0 };
 
-	View(uint8_t width, uint8_t height, Tile* pointOfView);
+	View(uint8_t width, uint8_t height, Tile pointOfView);
 
 	void render(std::unique_ptr<TextCellSubGrid> target);
 	
@@ -0,0 +1,181 @@
+//The world, a collection of planes joined by portals.
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <ranges>
+#include <string>
+#include <unordered_set>
+
+#include "world.hpp"
+
+
+World::World(uint64_t seed, size_t memoryBudget_, std::filesystem::path saveDir_)
+	: rng(seed), memoryBudget(memoryBudget_), saveDir(saveDir_)
+{
+	std::filesystem::create_directories(saveDir);
+}
+
+World::~World() {
+	//Evicted planes only live as long as the world does.
+	for (PlaneId id = 0; id < planes.size(); id++) {
+		std::error_code ignored{};
+		for (uint8_t saveFile : { 0, 1 }) std::filesystem::remove(savePath(id, saveFile), ignored);
+	}
+}
+
+std::filesystem::path World::savePath(PlaneId id, uint8_t saveFile) const {
+	return saveDir / ("plane-" + std::to_string(id) + "." + std::to_string(saveFile) + ".bin");
+}
+
+void World::adopt(PlaneId id) {
+	planes[id].plane->tiles.onPortal = [this](TileArena::Portal const& portal) {
+		//Portals may have been loaded from disk, so where they lead is checked before it's gone to.
+		if (portal.plane >= planes.size()) throw Plane::LoadError{ "Portal leads to a plane which isn't there." };
+		Plane& destination{ plane(portal.plane) };
+		if (portal.tile >= destination.tiles.size()) throw Plane::LoadError{ "Portal leads off the edge of its plane." };
+		return destination.tiles[portal.tile];
+	};
+}
+
+World::PlaneId World::addPlane() {
+	const auto id{ static_cast<PlaneId>(planes.size()) };
+	Philox seeds{ rng.substream(id, 0) };
+	const uint64_t seed{ uint64_t{ seeds() } << 32 | seeds() };
+	
+	planes.push_back({ std::make_unique<Plane>(seed), ++clock });
+	adopt(id);
+	return id;
+}
+
+Plane& World::plane(PlaneId id) {
+	Slot& slot{ planes.at(id) };
+	slot.lastUsed = ++clock;
+	
+	if (!slot.plane) {
+		slot.plane = std::make_unique<Plane>(savePath(id, slot.saveFile)); //Throws a Plane::LoadError, and stays evicted, if the file's gone, damaged, or badly linked.
+		adopt(id);
+	}
+	
+	return *slot.plane;
+}
+
+void World::connect(PlaneId a, PlaneId b) {
+	//A doorway is a tile edge we can link out of. Prefer ones nothing has
+	//been built past yet, then any a room was left with.
+	const auto claimDoorway{ [](Plane& plane) {
+		for (TileIndex i = static_cast<TileIndex>(plane.frontier.size()); i--;) {
+			auto& door{ plane.frontier[i] };
+			Link& link{ plane.tiles[door.tile].links()[door.edge] };
+			if (link.isFrontier() && link.tile() == i) {
+				link.set(Link{});
+				return std::pair{ door.tile, static_cast<uint8_t>(door.edge) };
+			}
+		}
+		for (auto& room : plane.rooms | std::views::reverse) {
+			if (room.connections.empty()) continue;
+			const auto door{ plane.takeConnection(room.connections) };
+			return std::pair{ door.tile, static_cast<uint8_t>(door.dir) };
+		}
+		assert(("Plane has no spare doorways to put a portal in.", false));
+		return std::pair{ Link::none, uint8_t{ 0 } };
+	} };
+	
+	Plane& planeA{ plane(a) };
+	Plane& planeB{ plane(b) };
+	const auto [tileA, edgeA] { claimDoorway(planeA) };
+	const auto [tileB, edgeB] { claimDoorway(planeB) };
+	
+	planeA.tiles.portals.push_back({ b, tileB });
+	planeA.tiles[tileA].links()[edgeA].setPortal(static_cast<uint32_t>(planeA.tiles.portals.size() - 1), edgeB);
+	planeB.tiles.portals.push_back({ a, tileA });
+	planeB.tiles[tileB].links()[edgeB].setPortal(static_cast<uint32_t>(planeB.tiles.portals.size() - 1), edgeA);
+	planeA.tiles.touch(tileA);
+	planeB.tiles.touch(tileB);
+}
+
+bool World::isEvictable(PlaneId id) const {
+	//Entities the plane owns are saved with it, and freed along with it. So
+	//a plane can't go while something from elsewhere is standing in it, nor
+	//while something of its own, such as the player, has wandered off into
+	//another plane and would be left dangling there.
+	Plane const& plane{ *planes[id].plane };
+	const std::unordered_set<Entity*> owned{ plane.entities.begin(), plane.entities.end() };
+	const auto isAllOwned{ [&](Plane const& where) {
+		return std::ranges::all_of(where.tiles.occupants, [&](auto& occupants) {
+			return std::ranges::all_of(occupants, [&](Entity* occupant) { return owned.contains(occupant); });
+		});
+	} };
+	const auto isNoneOwned{ [&](Plane const& where) {
+		return std::ranges::none_of(where.tiles.occupants, [&](auto& occupants) {
+			return std::ranges::any_of(occupants, [&](Entity* occupant) { return owned.contains(occupant); });
+		});
+	} };
+	
+	if (!isAllOwned(plane)) return false;
+	for (PlaneId other = 0; other < planes.size(); other++) {
+		//Evicted planes needn't be looked at. They were only evicted with nothing of anyone else's in them.
+		if (other != id && planes[other].plane && !isNoneOwned(*planes[other].plane)) return false;
+	}
+	return true;
+}
+
+void World::collect(Tile here) {
+	size_t resident{ residentBytes() };
+	if (resident <= memoryBudget) return;
+	
+	std::vector<PlaneId> byAge{};
+	for (PlaneId id = 0; id < planes.size(); id++) {
+		if (planes[id].plane) byAge.push_back(id);
+	}
+	std::ranges::sort(byAge, {}, [&](PlaneId id) { return planes[id].lastUsed; });
+	
+	for (PlaneId id : byAge) {
+		if (resident <= memoryBudget) break;
+		Slot& slot{ planes[id] };
+		if (slot.plane->tiles[here.index()] == here || !isEvictable(id)) continue;
+		
+		//The plane may still be mapped from its last save, so write the other
+		//file, and only let go of the last save once this one is safely down.
+		//Windows won't replace a file while it's mapped, so they can't swap
+		//places by renaming until the plane is freed, and by then it's too
+		//late to keep it if that fails.
+		const uint8_t saveFile{ static_cast<uint8_t>(!slot.saveFile) };
+		const std::filesystem::path path{ savePath(id, saveFile) };
+		std::ofstream out{ path, std::ios::binary | std::ios::trunc };
+		slot.plane->save(out);
+		out.close(); //Flushes. A short write, such as to a full disk, fails the stream here if not before.
+		if (!out) {
+			std::cerr << "Warning: Couldn't save plane " << id << " to " << path << ", keeping it in memory.\n";
+			std::error_code ignored{};
+			std::filesystem::remove(path, ignored);
+			continue;
+		}
+		
+		resident -= slot.plane->bytes();
+		slot.plane.reset();
+		std::error_code ignored{};
+		std::filesystem::remove(savePath(id, slot.saveFile), ignored); //Not there if the plane was never saved before.
+		slot.saveFile = saveFile;
+	}
+}
+
+bool World::isResident(PlaneId id) const {
+	return static_cast<bool>(planes.at(id).plane);
+}
+
+size_t World::residentBytes() const {
+	size_t total{ 0 };
+	for (auto& slot : planes) {
+		if (slot.plane) total += slot.plane->bytes();
+	}
+	return total;
+}
+
+MemoryReport World::memoryReport() const {
+	MemoryReport report{};
+	for (auto& slot : planes) {
+		if (slot.plane) report += slot.plane->memoryReport();
+	}
+	return report;
+}
@@ -0,0 +1,60 @@
+//The world, a collection of planes joined by portals.
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "places.hpp"
+
+class World {
+	//A world owns its planes, and keeps only so many of them in memory at
+	//once. When over budget, the planes used least recently are saved to disk
+	//and freed. Following a portal into a plane which has been freed loads it
+	//again, so portal links can be followed like any other link.
+
+public:
+	typedef uint32_t PlaneId;
+
+private:
+	struct Slot {
+		std::unique_ptr<Plane> plane{}; //Empty while evicted.
+		uint64_t lastUsed{ 0 };
+		uint8_t saveFile{ 0 }; //Which of the plane's two save files was written last. Each save goes to the other, so the one the plane may be mapped from is never written over.
+	};
+
+	const Philox rng; //Plane seeds are drawn from this, one stream per plane.
+	const size_t memoryBudget; //Bytes. Planes which can't be evicted may take us over it.
+	const std::filesystem::path saveDir;
+
+	std::vector<Slot> planes{};
+	uint64_t clock{ 0 }; //Ticks every time a plane is used, for least-recently-used eviction.
+
+	World(World&) = delete; //Planes point back at the world to follow portals.
+	World operator=(World&) = delete;
+
+	std::filesystem::path savePath(PlaneId id, uint8_t saveFile) const;
+	void adopt(PlaneId id); //Set up a newly created or loaded plane to follow portals through us.
+	bool isEvictable(PlaneId id) const; //Can the plane be saved and freed without leaving anything pointing into it?
+
+public:
+	World(uint64_t seed, size_t memoryBudget, std::filesystem::path saveDir);
+	~World();
+
+	PlaneId addPlane(); //Start a new, lazily-built plane.
+	Plane& plane(PlaneId id); //Loads the plane if it was evicted. Throws a Plane::LoadError if it can't be.
+
+	//Join two planes with a pair of portals, each in a spare doorway of its plane.
+	void connect(PlaneId a, PlaneId b);
+
+	//Evict planes until we're under budget. Not done on the fly, so tiles stay
+	//valid while a frame is being drawn. The plane here is kept, since the
+	//caller is standing in it. So is any plane which couldn't be saved.
+	void collect(Tile here);
+
+	bool isResident(PlaneId id) const;
+	size_t residentBytes() const;
+	MemoryReport memoryReport() const; //What the resident planes hold, added up.
+	size_t size() const { return planes.size(); }
+};
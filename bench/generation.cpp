@@ -0,0 +1,242 @@
+//Plane generation throughput. Builds planes of increasing size and reports
+//how fast their tiles were made, and how much memory each one takes.
+//
+//First, a plane is edited at random, with goals moved, tiles put in the way
+//and links cut, and its DistanceMap is checked against a full search after
+//every edit. Then paths are found between random tiles with a RoomGraph,
+//and their lengths checked against a plain Dijkstra's over the tiles. The
+//bench exits with a failure if either ever differs.
+//
+//Build with `make bench DEBUG=no OPTIMISE=yes SANITIZE_ADDRESS=no SANITIZE_UNDEFINED=no`
+//for representative numbers, then run ./generation-bench [chain|tree|clusters] [rooms…].
+//The defaults are a chain layout, and 10, 1k, 100k and 1M rooms. The last
+//needs a few GiB.
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <queue>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "distance_map.hpp"
+#include "places.hpp"
+#include "rng.hpp"
+#include "room_graph.hpp"
+
+
+static bool isWalkable(Link const& link) { return link && !link.isFrontier() && !link.isPortal(); }
+
+//Steps from each tile to the nearest goal, worked out from scratch.
+static std::vector<DistanceMap::Distance> searchFromGoals(TileArena const& tiles, std::span<const TileIndex> goals, DistanceMap::Distance radius) {
+	std::vector<DistanceMap::Distance> distances(tiles.size(), DistanceMap::unreached);
+	std::vector<TileIndex> queue{};
+	for (TileIndex goal : goals) {
+		if (distances[goal] == 0) continue;
+		distances[goal] = 0;
+		queue.push_back(goal);
+	}
+	for (size_t next = 0; next < queue.size(); next++) {
+		const TileIndex tile{ queue[next] };
+		if (distances[tile] >= radius) continue;
+		for (Link const& link : tiles.topology[tile].links) {
+			if (!isWalkable(link) || distances[link.tile()] != DistanceMap::unreached) continue;
+			distances[link.tile()] = distances[tile] + 1;
+			queue.push_back(link.tile());
+		}
+	}
+	return distances;
+}
+
+//Edit a plane at random, and check its distance map still matches a full search after each edit.
+static bool checkDistanceMap(Plane::Layout layout, int roomCount, DistanceMap::Distance radius, int edits) {
+	Plane plane{ 6, roomCount, layout };
+	TileArena& tiles{ *plane.getStartingTile().getArena() };
+	Philox rng{ 99 };
+	const auto anyTile{ [&] { return rng.below(static_cast<uint32_t>(tiles.size())); } };
+	
+	std::array<TileIndex, 3> goals{ plane.getStartingTile().index(), anyTile(), anyTile() };
+	DistanceMap map{ plane, radius };
+	std::vector<Tile> goalTiles{};
+	for (TileIndex goal : goals) goalTiles.push_back(tiles[goal]);
+	map.setGoals(goalTiles);
+	
+	size_t steps{ 0 }, jumps{ 0 }, insertions{ 0 }, cuts{ 0 };
+	for (int edit = 0; edit < edits; edit++) {
+		TileIndex& goal{ goals[rng.below(static_cast<uint32_t>(goals.size()))] };
+		const uint8_t edge{ static_cast<uint8_t>(rng.below(6)) };
+		const Link link{ tiles.topology[goal].links[edge] };
+		const uint32_t kind{ rng.below(8) };
+		if (kind == 0) { //Jump anywhere.
+			const TileIndex to{ anyTile() };
+			map.moveGoal(tiles[goal], tiles[to]);
+			goal = to;
+			jumps++;
+		}
+		else if (!isWalkable(link)) {
+			continue;
+		}
+		else if (kind == 1) { //Put a tile in the way.
+			const TileIndex added{ tiles.add() };
+			tiles[goal].insert(tiles[added], edge);
+			map.inserted(tiles[added]);
+			insertions++;
+		}
+		else if (kind == 2) { //Cut a link.
+			tiles[goal].unlink(edge);
+			map.relinked(std::array{ tiles[goal], tiles[link.tile()] });
+			cuts++;
+		}
+		else { //Step next door.
+			map.moveGoal(tiles[goal], tiles[link.tile()]);
+			goal = link.tile();
+			steps++;
+		}
+		
+		const auto distances{ searchFromGoals(tiles, goals, radius) };
+		for (TileIndex tile = 0; tile < distances.size(); tile++) {
+			if (map[tiles[tile]] == distances[tile] && map.isCurrent()) continue;
+			std::cout << "distance map differs from a full search after edit " << edit << ", radius " << radius
+				<< ": tile " << tile << " is " << map[tiles[tile]] << ", should be " << distances[tile] << "\n";
+			return false;
+		}
+	}
+	
+	std::cout
+		<< plane.roomCount() << "\t"
+		<< tiles.size() << "\t"
+		<< (radius == DistanceMap::unreached - 1 ? std::string{ "none" } : std::to_string(radius)) << "\t"
+		<< steps << "\t"
+		<< jumps << "\t"
+		<< insertions << "\t"
+		<< cuts << "\n";
+	return true;
+}
+
+//Steps from one tile to another, with Dijkstra's over every tile. Or nothing, if it can't be reached.
+static std::optional<uint32_t> searchBetween(TileArena const& tiles, TileIndex from, TileIndex to) {
+	constexpr uint32_t unreached{ UINT32_MAX };
+	std::vector<uint32_t> steps(tiles.size(), unreached);
+	typedef std::pair<uint32_t, TileIndex> Queued;
+	std::priority_queue<Queued, std::vector<Queued>, std::greater<Queued>> queue{};
+	steps[from] = 0;
+	queue.push({ 0, from });
+	while (!queue.empty()) {
+		const auto [distance, tile] { queue.top() };
+		queue.pop();
+		if (tile == to) return distance;
+		if (distance > steps[tile]) continue;
+		for (Link const& link : tiles.topology[tile].links) {
+			if (!isWalkable(link) || steps[link.tile()] <= distance + 1) continue;
+			steps[link.tile()] = distance + 1;
+			queue.push({ distance + 1, link.tile() });
+		}
+	}
+	return std::nullopt;
+}
+
+//Find paths between random tiles, and check each is as short as Dijkstra's finds and gets there.
+static bool checkRoomGraph(Plane::Layout layout, int roomCount, int cuts, int paths) {
+	Plane plane{ 6, roomCount, layout };
+	TileArena& tiles{ *plane.getStartingTile().getArena() };
+	Philox rng{ 98 };
+	const auto anyTile{ [&] { return rng.below(static_cast<uint32_t>(tiles.size())); } };
+	
+	//Cut some links first, so some paths have to go the long way round, or can't be found at all.
+	for (int cut = 0; cut < cuts; cut++) {
+		const TileIndex tile{ anyTile() };
+		const uint8_t edge{ static_cast<uint8_t>(rng.below(6)) };
+		if (isWalkable(tiles.topology[tile].links[edge])) tiles[tile].unlink(edge);
+	}
+	
+	const RoomGraph graph{ plane };
+	size_t found{ 0 }, steps{ 0 };
+	for (int query = 0; query < paths; query++) {
+		const TileIndex from{ anyTile() }, to{ anyTile() };
+		const auto path{ graph.findPath(tiles[from], tiles[to]) };
+		const auto expected{ searchBetween(tiles, from, to) };
+		
+		bool isGood{ path.has_value() == expected.has_value() };
+		if (isGood && path) {
+			isGood = path->size() == *expected;
+			TileIndex tile{ from };
+			for (uint8_t edge : *path) {
+				const Link link{ tiles.topology[tile].links[edge] };
+				if (!isWalkable(link)) { isGood = false; break; }
+				tile = link.tile();
+			}
+			isGood &= tile == to;
+			found++;
+			steps += path->size();
+		}
+		if (!isGood) {
+			std::cout << "room graph path differs from Dijkstra's, from tile " << from << " to " << to << ": "
+				<< (path ? std::to_string(path->size()) + " steps" : std::string{ "none" }) << ", should be "
+				<< (expected ? std::to_string(*expected) + " steps" : std::string{ "none" }) << "\n";
+			return false;
+		}
+	}
+	
+	std::cout
+		<< plane.roomCount() << "\t"
+		<< graph.doorwayCount() << "\t"
+		<< paths << "\t"
+		<< found << "\t"
+		<< (found ? static_cast<double>(steps) / found : 0.) << "\n";
+	return true;
+}
+
+
+int main(int argc, char* argv[]) {
+	Plane::Layout layout{ Plane::Layout::chain };
+	int arg{ 1 };
+	if (arg < argc) {
+		const std::string_view name{ argv[arg] };
+		if (name == "chain") arg++;
+		else if (name == "tree") { layout = Plane::Layout::tree; arg++; }
+		else if (name == "clusters") { layout = Plane::Layout::clusters; arg++; }
+	}
+	
+	std::vector<int> roomCounts{ 10, 1'000, 100'000, 1'000'000 };
+	if (arg < argc) {
+		roomCounts.clear();
+		for (; arg < argc; arg++) roomCounts.push_back(std::atoi(argv[arg]));
+	}
+	
+	std::cout << "distance map checks, same as a full search after every edit\n"
+		<< "rooms\ttiles\tradius\tsteps\tjumps\tinsertions\tcuts\n";
+	bool isGood{ true };
+	for (DistanceMap::Distance radius : { DistanceMap::Distance(DistanceMap::unreached - 1), DistanceMap::Distance(12) }) {
+		isGood &= checkDistanceMap(layout, 1'000, radius, 500);
+	}
+	
+	std::cout << "\nroom graph checks, as short as Dijkstra's and leading there\n"
+		<< "rooms\tdoorways\tpaths\tfound\tsteps/path\n";
+	isGood &= checkRoomGraph(layout, 1'000, 0, 200);
+	isGood &= checkRoomGraph(layout, 1'000, 2'000, 200);
+
+	std::cout << "\nrooms\ttiles\tms\ttiles/s\tbytes/tile\tcomponents\tlargest\n";
+	for (int roomCount : roomCounts) {
+		using clock = std::chrono::steady_clock;
+		const auto start{ clock::now() };
+		Plane plane{ 6, roomCount, layout };
+		const std::chrono::duration<double> elapsed{ clock::now() - start };
+
+		const auto tiles{ plane.tileCount() };
+		std::cout
+			<< plane.roomCount() << "\t"
+			<< tiles << "\t"
+			<< elapsed.count() * 1000 << "\t"
+			<< static_cast<uint64_t>(tiles / elapsed.count()) << "\t"
+			<< static_cast<double>(plane.bytes()) / tiles << "\t"
+			<< plane.roomComponentCount() << "\t"
+			<< plane.largestRoomComponent() << "\n";
+	}
+	
+	return isGood ? EXIT_SUCCESS : EXIT_FAILURE;
+}
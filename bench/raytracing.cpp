@@ -0,0 +1,311 @@
+//Raytracer throughput, and a check of the grid traversal it does.
+//
+//First, every ray View::render traces is traced across an open grid, and
+//the cells each passes through are checked: one step at a time, none
+//twice, each actually crossed by the line, and ending at the cell aimed
+//at. They're compared against the traversal the raytracer used to do,
+//which sampled points along the line and rounded them. Then the same
+//rays are traced over a generated plane, to see how many a second it
+//manages when walking real tiles, one by one and all at once as a RayFan.
+//Last, the fan is walked on several threads, and stepped a ring of cells
+//at a time by each of traceBatched's kernels. Each is checked to do just
+//what walking it on one thread does, over a plane built as it's seen, and
+//timed against it over the generated plane and over open ground.
+//
+//Build with `make bench DEBUG=no OPTIMISE=yes SANITIZE_ADDRESS=no SANITIZE_UNDEFINED=no`
+//for representative numbers, then run ./raytracing-bench [rooms] [frames].
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "places.hpp"
+#include "ray_fan.hpp"
+#include "raytracer.hpp"
+
+
+typedef std::pair<int, int> Cell;
+
+typedef RayFan::Ray Ray;
+
+//What Raytracer::trace did before it walked cell edges. Points along the
+//line were rounded to cells, and x was moved to before y.
+static std::vector<Cell> referenceTrace(Ray const& ray) {
+	std::vector<Cell> cells{};
+	auto [sx, sy, dx, dy] { ray };
+	int lastX{ static_cast<int>(sx) }, lastY{ static_cast<int>(sy) };
+	const auto moveTo{ [&](int x, int y) {
+		if (x == lastX && y == lastY) return;
+		cells.push_back({ x, y });
+		lastX = x;
+		lastY = y;
+	} };
+	const int steps = static_cast<int>(std::max(std::abs(sx - dx), std::abs(sy - dy)) + 1);
+	for (int step = 1; step <= steps; step++) {
+		const int x{ static_cast<int>(std::round(sx + (dx - sx) * step / steps)) };
+		const int y{ static_cast<int>(std::round(sy + (dy - sy) * step / steps)) };
+		moveTo(x, lastY);
+		moveTo(x, y);
+	}
+	return cells;
+}
+
+static bool crosses(Ray const& ray, Cell cell) { //Does the line touch the cell at all? (Liang-Barsky clipping.)
+	double enter{ 0 }, leave{ 1 };
+	const double slack{ 1e-9 };
+	const double delta[2]{ ray.dx - ray.sx, ray.dy - ray.sy };
+	const double start[2]{ ray.sx, ray.sy };
+	const int at[2]{ cell.first, cell.second };
+	for (int axis = 0; axis < 2; axis++) {
+		const double low{ at[axis] - 0.5 - slack }, high{ at[axis] + 0.5 + slack };
+		if (delta[axis] == 0) {
+			if (start[axis] < low || start[axis] > high) return false;
+			continue;
+		}
+		double t0{ (low - start[axis]) / delta[axis] }, t1{ (high - start[axis]) / delta[axis] };
+		if (t0 > t1) std::swap(t0, t1);
+		enter = std::max(enter, t0);
+		leave = std::min(leave, t1);
+	}
+	return enter <= leave;
+}
+
+struct CellRecorder : RaytracerVisitor {
+	std::vector<Cell>* cells;
+	inline void onEachTile(Tile, int x, int y) { cells->push_back({ x, y }); }
+};
+
+struct StepCounter : RaytracerVisitor {
+	uint64_t steps{ 0 };
+	inline void onEachTile(Tile, int, int) { steps++; }
+};
+
+//Link an arena of width×height tiles up into a torus, an open plane with
+//no walls where rays can't run off the edge. Returns the middle tile.
+static Tile makeTorus(TileArena& open, int width, int height) {
+	const auto at{ [&](int x, int y) { return open[static_cast<TileIndex>(((y + height) % height) * width + (x + width) % width)]; } };
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			at(x, y).link(at(x, y + 1), 0);
+			at(x, y).link(at(x + 1, y), 1);
+		}
+	}
+	return at(width / 2, height / 2);
+}
+
+//Check the traversal over an open plane, so every ray runs to its end.
+static bool checkTraversal(int width, int height) {
+	TileArena open{ static_cast<size_t>(width * height) };
+	std::vector<Cell> cells{};
+	BasicRaytracer<CellRecorder> raytracer{ CellRecorder{ .cells = &cells } };
+	raytracer.setOriginTile(makeTorus(open, width, height), 0);
+
+	size_t rays{ 0 }, bad{ 0 }, differing{ 0 }, steps{ 0 }, referenceSteps{ 0 };
+	std::set<Cell> covered{}, referenceCovered{};
+	for (Ray const& ray : RayFan::raysFor(width, height)) {
+		cells.clear();
+		raytracer.trace(ray.sx, ray.sy, ray.dx, ray.dy);
+		rays++;
+		steps += cells.size();
+
+		const Cell target{ static_cast<int>(std::floor(ray.dx + 0.5)), static_cast<int>(std::floor(ray.dy + 0.5)) };
+		Cell last{ static_cast<int>(ray.sx), static_cast<int>(ray.sy) };
+		std::set<Cell> seen{ last };
+		bool isGood{ true };
+		for (Cell cell : cells) {
+			isGood &= std::abs(cell.first - last.first) + std::abs(cell.second - last.second) == 1;
+			isGood &= seen.insert(cell).second;
+			isGood &= crosses(ray, cell);
+			last = cell;
+		}
+		isGood &= last == target;
+		if (!isGood) {
+			if (!bad) std::cout << "bad traversal towards " << ray.dx << "," << ray.dy << " in " << width << "x" << height << "\n";
+			bad++;
+		}
+		covered.insert(cells.begin(), cells.end());
+
+		const auto reference{ referenceTrace(ray) };
+		referenceSteps += reference.size();
+		differing += reference != cells;
+		referenceCovered.insert(reference.begin(), reference.end());
+	}
+
+	std::cout
+		<< width << "x" << height << "\t"
+		<< rays << "\t"
+		<< bad << "\t"
+		<< differing << "\t"
+		<< steps << "\t"
+		<< referenceSteps << "\t"
+		<< covered.size() << "\t"
+		<< referenceCovered.size() << "\t"
+		<< RayFan{ width, height }.stepCount() << "\n";
+	return !bad;
+}
+
+//What a view would show, by cell: the last ray to get there, and the tile it saw.
+typedef std::vector<std::pair<RayFan::RayId, Tile>> Frame;
+
+//trace(fan, start, dir, onTile) is one of the ways a fan can be traced.
+template<typename Trace>
+static Frame traceFrame(RayFan const& fan, Tile start, int dir, Trace&& trace) {
+	Frame frame(fan.width() * fan.height(), { 0, Tile{} });
+	trace(fan, start, dir, [&](Tile tile, int x, int y, RayFan::RayId ray) {
+		auto& cell{ frame[y * fan.width() + x] };
+		if (ray < cell.first) return;
+		cell = { ray, tile };
+	});
+	return frame;
+}
+
+const auto traceOnOneThread{ [](RayFan const& fan, Tile start, int dir, auto&& onTile) { return fan.trace(start, dir, onTile); } };
+
+//Check a way of tracing the fan does just what walking it on one thread
+//does. Two planes are built room by room as they're seen, and wandered
+//over in step, each frame starting from the furthest open tile the last
+//one showed. They should see the same tiles, and build the same rooms in
+//the same order.
+template<typename Trace>
+static bool checkSameAsOneThread(int width, int height, std::string const& tracing, Trace&& trace) {
+	const RayFan fan{ width, height };
+	{ //Open ground first, with nothing to build.
+		TileArena open{ static_cast<size_t>(width * height) };
+		const Tile centre{ makeTorus(open, width, height) };
+		if (traceFrame(fan, centre, 1, traceOnOneThread) != traceFrame(fan, centre, 1, trace)) {
+			std::cout << "trace over open ground differs, " << width << "x" << height << " " << tracing << "\n";
+			return false;
+		}
+	}
+	
+	Plane single{ 7 }, other{ 7 };
+	Tile from[2]{ single.getStartingTile(), other.getStartingTile() };
+	for (int f = 0; f < 40; f++) {
+		const Frame frames[2]{ traceFrame(fan, from[0], f & 3, traceOnOneThread), traceFrame(fan, from[1], f & 3, trace) };
+		for (size_t cell = 0; cell < frames[0].size(); cell++) {
+			auto [ray, tile] { frames[0][cell] };
+			auto [otherRay, otherTile] { frames[1][cell] };
+			if (ray != otherRay || bool(tile) != bool(otherTile) || (tile && tile.index() != otherTile.index())) {
+				std::cout << "trace differs at frame " << f << ", " << width << "x" << height << " " << tracing << "\n";
+				return false;
+			}
+		}
+		if (single.tileCount() != other.tileCount() || single.roomCount() != other.roomCount()) {
+			std::cout << "trace built differently at frame " << f << ", " << width << "x" << height << " " << tracing << "\n";
+			return false;
+		}
+		
+		for (size_t cell = 0; cell < frames[0].size(); cell++) {
+			if (frames[0][cell].second && !frames[0][cell].second->isOpaque()) {
+				from[0] = frames[0][cell].second;
+				from[1] = frames[1][cell].second;
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+
+int main(int argc, char* argv[]) {
+	const int roomCount{ argc > 1 ? std::atoi(argv[1]) : 1'000 };
+	const int frames{ argc > 2 ? std::atoi(argv[2]) : 200 };
+
+	std::cout << "view\trays\tbad\tdiffering from before\tsteps\tsteps before\tcells covered\tcovered before\tfan steps\n";
+	bool isGood{ true };
+	for (auto [width, height] : { Cell{ 81, 41 }, Cell{ 41, 21 }, Cell{ 200, 60 }, Cell{ 12, 7 } }) {
+		isGood &= checkTraversal(width, height);
+	}
+
+	std::cout << "\nview\trays/s\tsteps/s\tsteps/frame\tfan frames/s\tfan steps/frame\tas one by one\n";
+	Plane plane{ 6, roomCount };
+	for (auto [width, height] : { Cell{ 81, 41 }, Cell{ 200, 60 } }) {
+		const auto rays{ RayFan::raysFor(width, height) };
+		BasicRaytracer<StepCounter> raytracer{};
+		const RayFan fan{ width, height };
+		uint64_t fanSteps{ 0 };
+		
+		//Best of a few, since anything else running only ever slows us down.
+		using clock = std::chrono::steady_clock;
+		const auto timeBest{ [&](auto&& frame) {
+			std::chrono::duration<double> best{ INFINITY };
+			for (int run = 0; run < 5; run++) {
+				raytracer.visitor.steps = fanSteps = 0;
+				const auto start{ clock::now() };
+				for (int f = 0; f < frames; f++) frame(f & 3);
+				best = std::min<std::chrono::duration<double>>(best, clock::now() - start);
+			}
+			return best.count();
+		} };
+		const double tracing{ timeBest([&](int dir) {
+			raytracer.setOriginTile(plane.getStartingTile(), dir);
+			for (Ray const& ray : rays) raytracer.trace(ray.sx, ray.sy, ray.dx, ray.dy);
+		}) };
+		const uint64_t tracingSteps{ raytracer.visitor.steps };
+		const double fanning{ timeBest([&](int dir) {
+			fan.trace(plane.getStartingTile(), dir, [&](Tile, int, int, RayFan::RayId) { fanSteps++; });
+		}) };
+		
+		std::cout
+			<< width << "x" << height << "\t"
+			<< static_cast<uint64_t>(rays.size() * frames / tracing) << "\t"
+			<< static_cast<uint64_t>(tracingSteps / tracing) << "\t"
+			<< tracingSteps / frames << "\t"
+			<< static_cast<uint64_t>(frames / fanning) << "\t"
+			<< fanSteps / frames << "\t"
+			<< static_cast<uint64_t>(frames / tracing) << "\n";
+	}
+	
+	//Then the fan on several threads, and with rays stepped together in
+	//lanes, a ring of cells at a time, by each kernel this CPU can run.
+	std::cout << "\nview\ttracing\tsame as one thread\tfan frames/s\tx one thread\topen ground frames/s\tx one thread\n";
+	for (auto [width, height] : { Cell{ 81, 41 }, Cell{ 255, 255 } }) {
+		const RayFan fan{ width, height };
+		TileArena open{ static_cast<size_t>(width * height) };
+		const Tile centre{ makeTorus(open, width, height) };
+		double oneThread[2]{ 0, 0 }; //Frames per second over the plane and open ground, set by the first row.
+		const auto measure{ [&](std::string const& tracing, auto&& trace) {
+			const bool isSame{ checkSameAsOneThread(width, height, tracing, trace) };
+			isGood &= isSame;
+			
+			const auto timeBest{ [&](Tile start) {
+				double best{ INFINITY };
+				for (int run = 0; run < 5; run++) {
+					const auto begin{ std::chrono::steady_clock::now() };
+					for (int f = 0; f < frames; f++) trace(fan, start, f & 3, [](Tile, int, int, RayFan::RayId) {});
+					best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+				}
+				return best;
+			} };
+			const double rates[2]{ frames / timeBest(plane.getStartingTile()), frames / timeBest(centre) };
+			if (!oneThread[0]) std::copy(std::begin(rates), std::end(rates), oneThread);
+			std::cout
+				<< width << "x" << height << "\t"
+				<< tracing << "\t"
+				<< (isSame ? "yes" : "no") << "\t"
+				<< static_cast<uint64_t>(rates[0]) << "\t"
+				<< rates[0] / oneThread[0] << "\t"
+				<< static_cast<uint64_t>(rates[1]) << "\t"
+				<< rates[1] / oneThread[1] << "\n";
+		} };
+		
+		for (size_t workerCount : { 1, 2, 4, 8 }) {
+			measure(std::to_string(workerCount) + (workerCount == 1 ? " thread" : " threads"), [&](RayFan const& fan, Tile start, int dir, auto&& onTile) {
+				return fan.trace(start, dir, onTile, workerCount);
+			});
+		}
+		for (int kernel = 0; kernel <= static_cast<int>(RayFan::bestKernel()); kernel++) {
+			measure(std::string{ "batched, " } + RayFan::kernelNames[kernel], [&](RayFan const& fan, Tile start, int dir, auto&& onTile) {
+				return fan.traceBatched(start, dir, onTile, static_cast<RayFan::Kernel>(kernel));
+			});
+		}
+	}
+	
+	return isGood ? EXIT_SUCCESS : EXIT_FAILURE;
+}